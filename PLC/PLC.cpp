@@ -4,20 +4,37 @@
 #include "plc2svg.h"
 #include <PlcCompiler.h>
 
+namespace
+{
+  void plcParse(ParserInput<2>& parserInput, PlcAst& plcAst)
+  {
+    Parser<2, 2> parser(parserInput);
+    PlcParser<2, 2> plcParser(parser, plcAst);
+
+    plcParser.parse();
+  }
+}
+
 void plcParse(std::istream& in, PlcAst& plcAst)
 {
   ParserInput<2> parserInput(in);
-  Parser<2, 2> parser(parserInput);
-  PlcParser<2, 2> plcParser(parser, plcAst);
 
-  plcParser.parse();
+  plcParse(parserInput, plcAst);
 }
 
 void plcParse(const char *text, PlcAst& plcAst)
 {
-  std::istringstream in(text);
+  ParserInput<2> parserInput(text);
 
-  plcParse(in, plcAst);
+  plcParse(parserInput, plcAst);
+}
+
+void plcParseFile(const std::string& filename, PlcAst& plcAst)
+{
+  MappedFile file(filename);
+  ParserInput<2> parserInput(file);
+
+  plcParse(parserInput, plcAst);
 }
 
 void convert2svg(const PlcAst& plcAst, const plc::Expression& expression, const std::string& name
@@ -29,12 +46,17 @@ void convert2svg(const PlcAst& plcAst, const plc::Expression& expression, const
 }
 
 void convert2svg(const PlcAst& plcAst, std::ostream& out, const std::initializer_list<SVGOption> options)
+{
+  convert2svg(plcAst, out, std::vector<SVGOption>(options));
+}
+
+void convert2svg(const PlcAst& plcAst, std::ostream& out, const std::vector<SVGOption>& options)
 {
   Plc2svg plc2svg(plcAst, out, options);
 
   std::vector<std::string> names;
   for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
-    if (plcAst.getVariable(it->first).type() == Variable::Type::Output && it->second.expression().operator bool())
+    if (plcAst.getVariable(it->first).type() == Variable::Type::Output && it->second.expression())
       names.emplace_back(it->first);
 
   plc2svg.convertMultiple(names);
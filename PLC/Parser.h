@@ -57,41 +57,20 @@ public:
     {
       if( isalpha(c) || c == '_')
       { 
-        std::ostringstream identifier;
-        identifier << c;
-
-        for (;;)
-        {
-          c = parserInput.nextChar();
-          if (isalpha(c) || isdigit(c) || c == '_')
-            identifier << c;
-          else
-            break;
-        }
-
-        parserInput.pushChar(c);
-
-        parserResult = identifier.str();
+        parserResult = parserInput.token(c, [](char ch) { return isalpha(ch) || isdigit(ch) || ch == '_'; });
       }
       else if (isdigit(c))
       {
-        uint64_t result= 0;
-        std::string text;
-        text.reserve(24);
+        boost::string_view text(parserInput.token(c, [](char ch) { return isdigit(ch) != 0; }));
 
-        while (isdigit(c))
+        uint64_t result= 0;
+        for (char digit : text)
         {
           result *= 10;
-          result += (c - '0');
-
-          text += c;
-          c = parserInput.nextChar();
+          result += (digit - '0');
         }
 
-        parserInput.pushChar(c);
-
-        ParserResult tmp( result, text );
-        parserResult.swap(tmp);
+        parserResult = ParserResult( result, text );
       }
       else
       {
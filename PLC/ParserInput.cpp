@@ -0,0 +1,75 @@
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ParserInput.h"
+
+MappedFile::MappedFile(const std::string& filename)
+{
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    throw PlcException("can not open '%s'", filename.c_str());
+
+  file_ = file;
+  LARGE_INTEGER size;
+  GetFileSizeEx(file, &size);
+  size_ = size_t(size.QuadPart);
+  if (size_)
+  {
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_)
+      data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_)
+    {
+      close();
+      throw PlcException("can not map '%s'", filename.c_str());
+    }
+  }
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw PlcException("can not open '%s'", filename.c_str());
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    size_ = size_t(st.st_size);
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED)
+      data_ = static_cast<const char*>(data);
+  }
+  ::close(fd);
+
+  if (size_ && !data_)
+    throw PlcException("can not map '%s'", filename.c_str());
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+  if (data_)
+    UnmapViewOfFile(data_);
+  if (mapping_)
+    CloseHandle(mapping_);
+  if (file_)
+    CloseHandle(file_);
+  mapping_ = file_ = nullptr;
+#else
+  if (data_)
+    munmap(const_cast<char*>(data_), size_);
+#endif
+  data_ = nullptr;
+}
@@ -1,28 +1,97 @@
 #ifndef _INCLUDE_PARSER_INPUT_H_
+#define _INCLUDE_PARSER_INPUT_H_
 
 #include <istream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <deque>
+
+#include <boost/utility/string_view.hpp>
 
 #include "Stack.h"
+#include "PlcException.h"
+
+/// <summary>
+/// A file mapped read only into memory, an empty file has no mapping.
+/// </summary>
+class MappedFile
+{
+public:
+
+  MappedFile(const std::string& filename);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile()
+  {
+    close();
+  }
+
+  const char *data() const
+  {
+    return data_;
+  }
+
+  size_t size() const
+  {
+    return size_;
+  }
+
+private:
+
+  void close();
+
+  // the handles of the file and of its mapping on Windows
+  void *file_ = nullptr;
+  void *mapping_ = nullptr;
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
 
+/// <summary>
+/// The characters of the source, from one contiguous buffer: a stream is read at once,
+/// a text or a MappedFile is used in place and has to outlive the ParserInput.
+/// A pushed back character, which was just read, only moves the position back.
+/// </summary>
 template<unsigned STACKSIZE>
 class ParserInput
 {
 public:
 
-  ParserInput(std::istream& in) : in(in) {}
+  ParserInput(std::istream& in)
+  {
+    std::ostringstream buffer;
+    if (in && in.rdbuf()->sgetc() != std::char_traits<char>::eof())
+      buffer << in.rdbuf();
+
+    buffer_ = buffer.str();
+    position_ = begin_ = buffer_.data();
+    end_ = begin_ + buffer_.size();
+  }
+
+  ParserInput(const char *begin, const char *end) : begin_(begin), position_(begin), end_(end) {}
+
+  ParserInput(const char *text) : ParserInput(text, text + strlen(text)) {}
+
+  ParserInput(const MappedFile& file) : ParserInput(file.data(), file.data() + file.size()) {}
+
+  ParserInput(const ParserInput&) = delete;
+  ParserInput& operator=(const ParserInput&) = delete;
 
   char nextChar()
   {
     if (stack)
-      return stack.pop();
-
-    if (in)
     {
-      int i = in.get();
-      if (i > 0)
-        return char(i);
+      fromBuffer_ = false;
+      return stack.pop();
     }
 
+    fromBuffer_ = true;
+    if (position_ != end_)
+      return *position_++;
+
     return 0;
   }
 
@@ -39,14 +108,79 @@ public:
 
   void pushChar(char c)
   {
-    stack.push(c);
+    if (!stack && position_ != begin_ && position_[-1] == c)
+      position_--;
+    else if (c || stack || position_ != end_)
+      stack.push(c);
+  }
+
+  /// <summary>
+  /// Appends the following characters as long as the predicate holds, the first other one
+  /// is left in the input. The run in the buffer is appended at once.
+  /// </summary>
+  template<typename Predicate>
+  void appendWhile(std::string& text, Predicate predicate)
+  {
+    while (stack)
+    {
+      char c = stack.pop();
+      if (!predicate(c))
+      {
+        stack.push(c);
+        return;
+      }
+
+      text += c;
+    }
+
+    const char *start = position_;
+    while (position_ != end_ && predicate(*position_))
+      position_++;
+
+    text.append(start, position_);
+  }
+
+  /// <summary>
+  /// The token of the character just read and the following characters, as long as the
+  /// predicate holds. It is a view into the buffer, only a token starting with a pushed back
+  /// character is copied, the copy lives as long as this ParserInput.
+  /// </summary>
+  template<typename Predicate>
+  boost::string_view token(char first, Predicate predicate)
+  {
+    if (fromBuffer_ && !stack)
+    {
+      const char *start = position_ - 1;
+      while (position_ != end_ && predicate(*position_))
+        position_++;
+
+      return boost::string_view(start, size_t(position_ - start));
+    }
+
+    copies_.emplace_back(1, first);
+    appendWhile(copies_.back(), predicate);
+
+    return copies_.back();
+  }
+
+  /// <summary>
+  /// The number of characters read from the buffer
+  /// </summary>
+  size_t position() const
+  {
+    return size_t(position_ - begin_);
   }
 
 private:
 
-  std::istream& in;
+  std::string buffer_;
+  const char *begin_;
+  const char *position_;
+  const char *end_;
+  // the last character of nextChar() came from the buffer
+  bool fromBuffer_ = false;
+  std::deque<std::string> copies_;
 
   Stack<char, STACKSIZE> stack;
 };
 #endif // !_INCLUDE_PARSER_INPUT_H_
-
@@ -2,7 +2,16 @@
 #define _INCLUDE_PARSER_RESULT_H_
 
 #include <string>
+#include <cstdint>
+#include <ostream>
+#include <type_traits>
 
+#include <boost/utility/string_view.hpp>
+
+/// <summary>
+/// A token of the Parser. The text is a view into the source buffer of the ParserInput and
+/// valid as long as it, a Char keeps its character itself: no token allocates.
+/// </summary>
 class ParserResult
 {
 public:
@@ -20,43 +29,20 @@ public:
     clear();
   }
 
-  ParserResult(const ParserResult& other)
-  {
-    *this = other;
-  }
-
-  ParserResult(ParserResult&& other)
-  {
-    swap(other);
-  }
+  ParserResult(const ParserResult& other) = default;
 
-  ParserResult(uint64_t intValue, std::string& text)
+  ParserResult(uint64_t intValue, boost::string_view text)
   {
     type_ = Type::Integer;
     intValue_ = intValue;
-    text_.swap(text);
-  }
-
-  ParserResult& operator =(const ParserResult& other)
-  {
-    type_ = other.type_;
-    text_ = other.text_;
-    intValue_ = other.intValue_;
-
-    return *this;
+    text_ = text;
   }
 
-  ParserResult& operator =(const std::string& string)
-  {
-    text_ = string;
-    type_ = Type::Identifier;
-
-    return *this;
-  }
+  ParserResult& operator =(const ParserResult& other) = default;
 
-  ParserResult& operator =(std::string&& string)
+  ParserResult& operator =(boost::string_view identifier)
   {
-    string.swap(text_);
+    text_ = identifier;
     type_ = Type::Identifier;
 
     return *this;
@@ -64,7 +50,7 @@ public:
 
   ParserResult& operator =(char c)
   {
-    text_= c;
+    char_ = c;
     type_ = Type::Char;
     intValue_ = c;
 
@@ -97,15 +83,10 @@ public:
 
   void swap(ParserResult& other)
   {
-    if (this != &other)
-    {
-      Type tmp = type_;
-      type_= other.type_;
-      other.type_ = tmp;
-
-      text_.swap(other.text_);
-      std::swap(intValue_, other.intValue_);
-    }
+    std::swap(type_, other.type_);
+    std::swap(text_, other.text_);
+    std::swap(intValue_, other.intValue_);
+    std::swap(char_, other.char_);
   }
 
   void clear()
@@ -118,9 +99,17 @@ public:
     return type_;
   }
 
-  const std::string& text() const
+  boost::string_view text() const
+  {
+    return type_ == Type::Char ? boost::string_view(&char_, 1) : text_;
+  }
+
+  /// <summary>
+  /// A copy of the text, for names kept beyond the source buffer
+  /// </summary>
+  std::string string() const
   {
-    return text_;
+    return text().to_string();
   }
 
   uint64_t intValue() const
@@ -135,24 +124,27 @@ public:
 
   bool is(Type type, const char *text) const
   {
-    return type == type_ && text == text_;
+    return type == type_ && text == this->text();
   }
 
-  bool is(Type type, const std::string& text) const
+  bool is(Type type, boost::string_view text) const
   {
-    return type == type_ && text == text_;
+    return type == type_ && text == this->text();
   }
 
-  bool is(Type type, uint64_t ui) const
+  // any integral type, an integer literal must not be ambiguous with a null pointer
+  template<typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+  bool is(Type type, T ui) const
   {
-    return type == type_ && intValue_ == ui;
+    return type == type_ && intValue_ == uint64_t(ui);
   }
 
 private:
 
   Type type_;
-  std::string text_;
-  uint64_t intValue_;
+  boost::string_view text_;
+  uint64_t intValue_ = 0;
+  char char_ = 0;
 };
 
 std::ostream& operator<<(std::ostream& out, ParserResult& parserResult);
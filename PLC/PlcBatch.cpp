@@ -0,0 +1,40 @@
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <glob.h>
+#endif
+
+#include "PlcBatch.h"
+
+void plc::matchFiles(const std::string& pattern, std::vector<std::string>& files)
+{
+#ifdef _WIN32
+  size_t slash = pattern.find_last_of("/\\");
+  std::string directory = (slash == std::string::npos) ? std::string() : pattern.substr(0, slash + 1);
+
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA(pattern.c_str(), &data);
+  if (find != INVALID_HANDLE_VALUE)
+  {
+    do
+    {
+      if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        files.emplace_back(directory + data.cFileName);
+    } while (FindNextFileA(find, &data));
+
+    FindClose(find);
+  }
+#else
+  glob_t found;
+  if (glob(pattern.c_str(), 0, nullptr, &found) == 0)
+    files.insert(files.end(), found.gl_pathv, found.gl_pathv + found.gl_pathc);
+
+  globfree(&found);
+#endif
+}
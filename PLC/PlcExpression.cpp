@@ -1,8 +1,6 @@
 #include "PlcExpression.h"
 
 
-unsigned plc::Expression::idCounter = 0;
-
 std::ostream& operator<<(std::ostream& out, const plc::Term& term)
 {
   out << "Term(";
@@ -70,12 +68,24 @@ namespace plc
 {
   void Term::operator=(const Term& other)
   {
+    if (&other == this)
+      return;
+
+    release();
     unary_ = other.unary_;
     type_ = other.type_;
-    if (other.expression_)
-      expression_.reset(new Expression(*other.expression_));
+    if (other.shared_)
+    {
+      expression_ = other.expression_;
+      shared_ = true;
+    }
+    else if (other.expression_)
+    {
+      expression_ = new Expression(*other.expression_);
+      owned_ = true;
+    }
     //identifier_ = other.identifier_;
     variable_ = other.variable_;
   }
 
-}
\ No newline at end of file
+}
\ No newline at end of file
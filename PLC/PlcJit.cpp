@@ -0,0 +1,54 @@
+#include <cstring>
+
+#include "PlcJit.h"
+
+#ifdef PLC_JIT
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+void *PlcJitProgram::allocateCode(const std::vector<uint8_t>& code)
+{
+#ifdef _WIN32
+  void *memory = VirtualAlloc(nullptr, code.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+  if (!memory)
+    throw PlcException("can not allocate %d bytes of code", unsigned(code.size()));
+  std::memcpy(memory, code.data(), code.size());
+  DWORD protection;
+  if (!VirtualProtect(memory, code.size(), PAGE_EXECUTE_READ, &protection))
+  {
+    VirtualFree(memory, 0, MEM_RELEASE);
+    throw PlcException("can not make the code executable");
+  }
+#else
+  void *memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)
+    throw PlcException("can not allocate %d bytes of code", unsigned(code.size()));
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC))
+  {
+    munmap(memory, code.size());
+    throw PlcException("can not make the code executable");
+  }
+#endif
+
+  return memory;
+}
+
+void PlcJitProgram::freeCode(void *memory, size_t size)
+{
+#ifdef _WIN32
+  VirtualFree(memory, 0, MEM_RELEASE);
+#else
+  munmap(memory, size);
+#endif
+}
+#endif
@@ -31,8 +31,10 @@ public:
           parseVariables(Variable::Type::Monoflop);
         else if (boost::algorithm::iequals(parserResult.text(), "flags"))
           parseVariables(Variable::Type::Flag);
+        else if (boost::algorithm::iequals(parserResult.text(), "constants"))
+          parseConstants();
         else
-          parseEquation(parserResult.text());
+          parseEquation(parserResult.string());
       }
       else if (!parserResult)
       {
@@ -43,6 +45,8 @@ public:
         throw ParserException("Syntax Error");
       }
     }
+
+    plcAst.allocateIndices();
   }
 
 protected:
@@ -61,13 +65,13 @@ protected:
     }
     else if (parserResult.is(ParserResult::Type::Char, '('))
     {
-      std::unique_ptr<plc::Expression> expression(new plc::Expression());
+      plc::Expression *expression = plcAst.arena().create();
       parseExpression(expression);
 
       if (!parser.next(parserResult).is(ParserResult::Type::Char, ')'))
         throw ParserException("missing closing ')'");
 
-      term = expression;
+      term.setExpression(expression);
     }
     else
       throw ParserException("Syntax Error");
@@ -76,18 +80,22 @@ protected:
   static plc::Expression::Operator toOperator(ParserResult& parserResult)
   {
     if (parserResult.type() != ParserResult::Type::Char)
-      throw ParserException("Syntax Error, Operator expected, but got '%s'", parserResult.text().c_str());
+      throw ParserException("Syntax Error, Operator expected, but got '%s'", parserResult.string().c_str());
 
     switch (parserResult.intValue())
     {
     case '&': return plc::Expression::Operator::And;
     case '|': return plc::Expression::Operator::Or;
     default:
-      throw ParserException("Syntax Error, undefined Operator: '%s'", parserResult.text().c_str());
+      throw ParserException("Syntax Error, undefined Operator: '%s'", parserResult.string().c_str());
     }
   }
 
-  void parseExpression(std::unique_ptr<plc::Expression>& expression)
+  /// <summary>
+  /// Parses into expression, which is replaced by a new one of the ExpressionArena of the PlcAst,
+  /// if an operator of lower precedence follows.
+  /// </summary>
+  void parseExpression(plc::Expression*& expression)
   {
     ParserResult parserResult;
     for (;;)
@@ -112,11 +120,12 @@ protected:
       }
       else if(expression->op() < op)
       {
-        std::unique_ptr<plc::Expression> tmp(new plc::Expression(term, op));
+        plc::Expression *tmp = plcAst.arena().create(term, op);
 
         parseExpression(tmp);
 
-        plc::Term otherTerm(tmp);
+        plc::Term otherTerm;
+        otherTerm.setExpression(tmp);
         expression->addTerm(otherTerm);
         break;
       }
@@ -124,8 +133,9 @@ protected:
       {
         expression->addTerm(term);
 
-        plc::Term firstTerm(expression);
-        expression.reset(new plc::Expression(firstTerm));
+        plc::Term firstTerm;
+        firstTerm.setExpression(expression);
+        expression = plcAst.arena().create(firstTerm);
 
         expression->op() = op;
       }
@@ -139,16 +149,16 @@ protected:
       throw ParserException("missing '=' after variable '%s' equation", name.c_str());
 
     Variable& variable = plcAst.getVariable(name);
-    std::unique_ptr<plc::Expression> expression(new plc::Expression(variable.index()));
+    plc::Expression *expression = plcAst.arena().create(variable.index());
     parseExpression(expression);
     if (!parser.next(parserResult).is(ParserResult::Type::Char, ';'))
       throw ParserException("missing ';' after expression");
 
-    if (variable.expression().operator bool())
-      throw ParserException("Two Expressions are assigned to Variable '%s'", name);
+    if (variable.expression())
+      throw ParserException("Two Expressions are assigned to Variable '%s'", name.c_str());
 
-    variable.expression().swap(expression);
-    variable.expression()->setVariable(&variable);
+    variable.setExpression(expression);
+    expression->setVariable(&variable);
   }
 
   void parseVariables(Variable::Type type)
@@ -163,14 +173,14 @@ protected:
         throw ParserException("missing identifier in variable declaration");
 
       if (plcAst.variableExists(parserResult.text()))
-        throw ParserException("Variable '%s' already declared", parserResult.text().c_str());
+        throw ParserException("Variable '%s' already declared", parserResult.string().c_str());
 
       uint64_t timeArg = (type == Variable::Type::Monoflop) ? 30 : 0;
       ParserResult parserResult2;
       if (parser.next(parserResult2).is(ParserResult::Type::Char, '(') && type == Variable::Type::Monoflop)
       {
         if (parser.next(parserResult2).type() != ParserResult::Type::Integer)
-          throw ParserException("missing Integer Value after Variable '%s' (", parserResult.text().c_str());
+          throw ParserException("missing Integer Value after Variable '%s' (", parserResult.string().c_str());
 
         timeArg = parserResult2.intValue();
 
@@ -181,28 +191,36 @@ protected:
         else if (parserResult2.is(ParserResult::Type::Identifier, "h"))
           timeArg *= 1800;
         else
-          throw ParserException("missing Time unit (s,min,h) after Variable '%s' (%d", parserResult.text().c_str(), timeArg);
+          throw ParserException("missing Time unit (s,min,h) after Variable '%s' (%d", parserResult.string().c_str(), timeArg);
 
         if (timeArg > 65535)
-          throw ParserException("Variable '%s' Time value overflow, max is 131071 s", parserResult.text().c_str());
+          throw ParserException("Variable '%s' Time value overflow, max is 131071 s", parserResult.string().c_str());
 
         if (!parser.next(parserResult2).is(ParserResult::Type::Char, ')'))
-          throw ParserException("missing ')' after Variable '%s'", parserResult.text().c_str());
+          throw ParserException("missing ')' after Variable '%s'", parserResult.string().c_str());
 
         parser.next(parserResult2);
       }
 
-      if(!parserResult2.is(ParserResult::Type::Char,'='))
-        throw ParserException("missing '=' after Variable '%s'", parserResult.text().c_str());
-      if (parser.next(parserResult2).type() != ParserResult::Type::Integer)
-        throw ParserException("missing integer value after Variable '%s'=", parserResult.text().c_str());
+      // flags and monoflops without index are allocated after parsing
+      unsigned index = Variable::AUTO_INDEX;
+      if (parserResult2.is(ParserResult::Type::Char, '='))
+      {
+        if (parser.next(parserResult2).type() != ParserResult::Type::Integer)
+          throw ParserException("missing integer value after Variable '%s'=", parserResult.string().c_str());
+
+        index = unsigned(parserResult2.intValue());
+        parser.next(parserResult2);
+      }
+      else if (type != Variable::Type::Flag && type != Variable::Type::Monoflop)
+        throw ParserException("missing '=' after Variable '%s'", parserResult.string().c_str());
 
-      plcAst.addVariable( Variable(parserResult.text(), type, unsigned( parserResult2.intValue()), unsigned(timeArg)));
+      plcAst.addVariable( Variable(parserResult.string(), type, index, unsigned(timeArg)));
 
-      if (parser.next(parserResult).is(ParserResult::Type::Char, ','))
+      if (parserResult2.is(ParserResult::Type::Char, ','))
         continue;
 
-      if (parserResult.is(ParserResult::Type::Char, ';'))
+      if (parserResult2.is(ParserResult::Type::Char, ';'))
         break;
 
       throw ParserException("missing ',' in Variable list");
@@ -210,6 +228,43 @@ protected:
 
   }
   
+  // constants: input=0|1 [, input=0|1]* ;
+  void parseConstants()
+  {
+    ParserResult parserResult;
+    if (!parser.next(parserResult).is(ParserResult::Type::Char, ':'))
+      throw ParserException("missing ':' after constants");
+
+    for (;;)
+    {
+      if (parser.next(parserResult).type() != ParserResult::Type::Identifier)
+        throw ParserException("missing identifier in constant declaration");
+
+      ParserResult parserResult2;
+      if (!parser.next(parserResult2).is(ParserResult::Type::Char, '='))
+        throw ParserException("missing '=' after constant '%s'", parserResult.string().c_str());
+      if (parser.next(parserResult2).type() != ParserResult::Type::Integer || parserResult2.intValue() > 1)
+        throw ParserException("constant '%s' must be 0 or 1", parserResult.string().c_str());
+
+      try
+      {
+        plcAst.setConstant(parserResult.string(), parserResult2.intValue() != 0);
+      }
+      catch (const PlcAstException& ex)
+      {
+        throw ParserException("%s", ex.what());
+      }
+
+      if (parser.next(parserResult).is(ParserResult::Type::Char, ','))
+        continue;
+
+      if (parserResult.is(ParserResult::Type::Char, ';'))
+        break;
+
+      throw ParserException("missing ',' in constant list");
+    }
+  }
+
   Parser<CHAR_STACKSIZE,PARSER_STACKSIZE>& parser;
   PlcAst& plcAst;
 };
@@ -2,6 +2,7 @@
 #define _INCLUDE_STACK_H_
 
 #include <array>
+#include <vector>
 #include <exception>
 
 class StackOverflowException : public std::exception
@@ -0,0 +1,120 @@
+#ifdef PARSER_TESTS
+
+#include <sstream>
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcOptimizer.h"
+#include "../include/AvrDisassembler.h"
+
+BOOST_AUTO_TEST_CASE(AvrDisassembler_RoundTrip)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3, g=70;"
+    "outputs: o0=0, o1=1, o3=65; flags: f0=0, latch=40; monoflops: m(4s)=0;"
+    "f0 = a & b; o0 = f0 & !d | c; latch = g | latch & !b; o1 = !f0 & !(a | c); m = d; o3 = m | latch & b;", plcAst);
+
+  for (bool fused : { false, true })
+  {
+    std::vector<plc::Operation> instructions;
+    plc::PlcOptimizer optimizer(plcAst, fused ? std::vector<plc::CompileOption>{ plc::CompileOption::FusedOperations } : std::vector<plc::CompileOption>());
+    optimizer.compile(instructions);
+
+    std::vector<uint8_t> avrplc;
+    plc::translateAvr(instructions, avrplc);
+
+    std::vector<plc::Operation> decoded;
+    std::vector<unsigned> addresses;
+    plc::decodeAvr(avrplc, decoded, &addresses);
+
+    BOOST_REQUIRE_EQUAL(decoded.size(), instructions.size());
+    BOOST_REQUIRE_EQUAL(addresses.size(), instructions.size());
+    for (unsigned i = 0; i < instructions.size(); i++)
+    {
+      BOOST_CHECK(decoded[i].instruction == instructions[i].instruction);
+      BOOST_CHECK_EQUAL(decoded[i].argument, instructions[i].argument);
+    }
+
+    std::vector<plc::EquationSize> sizes(plc::equationSizes(avrplc));
+    BOOST_REQUIRE_EQUAL(sizes.size(), 6u);
+    unsigned bytes = 0;
+    for (const plc::EquationSize& size : sizes)
+    {
+      BOOST_CHECK_EQUAL(size.address, bytes);
+      bytes += size.bytes;
+    }
+    BOOST_CHECK_EQUAL(bytes, unsigned(avrplc.size()));
+  }
+
+  std::vector<plc::Operation> decoded;
+  BOOST_CHECK_THROW(plc::decodeAvr({ avrplc::READ_INPUT, avrplc::OPERATION | 6 }, decoded), PlcException);
+  BOOST_CHECK_THROW(plc::decodeAvr({ avrplc::READ_INPUT | avrplc::ARGUMENT_EXTENDED }, decoded), PlcException);
+  BOOST_CHECK_THROW(plc::decodeAvr({ avrplc::READ_INPUT | avrplc::ARGUMENT_EXTENDED, avrplc::ARGUMENT_WIDE, 1 }, decoded), PlcException);
+}
+
+BOOST_AUTO_TEST_CASE(AvrDisassembler_Versions)
+{
+  using plc::Instruction;
+
+  std::vector<plc::Operation> instructions{ { Instruction::ReadInput, 30 }, { Instruction::ReadInput, 31 },
+    { Instruction::OperationAnd, 0 }, { Instruction::ReadFlag, 285 }, { Instruction::OperationOr, 0 }, { Instruction::WriteFlag, 286 },
+    { Instruction::ReadFlag, 65535 }, { Instruction::WriteOuput, 0x1234 } };
+
+  std::vector<uint8_t> avrplc;
+  plc::translateAvr(instructions, avrplc, avrplc::VERSION_2);
+  BOOST_CHECK(avrplc == std::vector<uint8_t>({ 0x1e, 0x1f, 0x00, 0x81, 0x5f, 0xfe, 0x82, 0xdf, 0xff, 0x1e, 0x01,
+    0x5f, 0xff, 0xff, 0xff, 0xbf, 0xff, 0x34, 0x12 }));
+
+  std::vector<plc::Operation> decoded;
+  plc::decodeAvr(avrplc, decoded);
+  BOOST_REQUIRE_EQUAL(decoded.size(), instructions.size());
+  for (unsigned i = 0; i < instructions.size(); i++)
+    BOOST_CHECK_EQUAL(decoded[i].argument, instructions[i].argument);
+
+  std::vector<uint8_t> version1;
+  BOOST_CHECK_THROW(plc::translateAvr(instructions, version1, avrplc::VERSION_1), PlcException);
+  instructions.resize(5);
+  version1.clear();
+  plc::translateAvr(instructions, version1, avrplc::VERSION_1);
+  BOOST_CHECK(version1 == std::vector<uint8_t>(avrplc.begin(), avrplc.begin() + 7));
+
+  instructions.emplace_back(plc::Operation{ Instruction::WriteFlag, 65536 });
+  BOOST_CHECK_THROW(plc::translateAvr(instructions, version1, avrplc::VERSION_2), PlcException);
+}
+
+BOOST_AUTO_TEST_CASE(AvrDisassembler_Listing)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, g=40; outputs: q=0;", plcAst);
+  plc::VariableNames names(plcAst);
+
+  std::vector<uint8_t> avrplc{ avrplc::READ_INPUT, avrplc::READ_INPUT | avrplc::ARGUMENT_EXTENDED, 40 - avrplc::ARGUMENT_EXTENDED,
+    avrplc::OPERATION | avrplc::AND_NOT, avrplc::WRITE_OUTPUT, avrplc::READ_OUTPUT, avrplc::WRITE_FLAG | 3 };
+
+  std::ostringstream out;
+  plc::disassembleAvr(avrplc, names, out);
+  BOOST_CHECK_EQUAL(out.str(),
+    "0000  00     Read Input a\n"
+    "0001  1F 09  Read Input g\n"
+    "0003  83     And Not\n"
+    "0004  A0     Write Output q\n"
+    "\n"
+    "0005  20     Read Output q\n"
+    "0006  C3     Write Flag flag 3\n"
+    "\n");
+
+  std::vector<plc::EquationSize> after(plc::equationSizes(avrplc));
+  avrplc.insert(avrplc.begin() + 3, avrplc::OPERATION | avrplc::NOT);
+  std::vector<plc::EquationSize> before(plc::equationSizes(avrplc));
+  before.emplace_back(before.back());
+
+  std::vector<plc::SizeDifference> differences(plc::compareSizes(before, after, names));
+  BOOST_REQUIRE_EQUAL(differences.size(), 2u);
+  BOOST_CHECK_EQUAL(differences[0].name, "q");
+  BOOST_CHECK_EQUAL(differences[0].bytesBefore, 6u);
+  BOOST_CHECK_EQUAL(differences[0].bytesAfter, 5u);
+  BOOST_CHECK_EQUAL(differences[1].name, "flag 3#2");
+  BOOST_CHECK_EQUAL(differences[1].bytesAfter, 0u);
+}
+
+#endif // PARSER_TESTS
@@ -0,0 +1,111 @@
+#ifdef PARSER_TESTS
+
+#include <random>
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcOptimizer.h"
+#include "../include/PlcScanSimulator.h"
+#include "../include/AvrEmulator.h"
+
+BOOST_AUTO_TEST_CASE(AvrEmulator_Equivalence)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3, e=4, g=70;"
+    "outputs: o0=0, o1=1, o2=2, o3=65; flags: f0=0, f1=1, latch=2; monoflops: m(4s)=0, n=1;"
+    "f0 = a & b; f1 = f0 | c & !g; o0 = f1 & !d; o1 = !f0 & e | !(a | c);"
+    "latch = e | latch & !g; o2 = latch; m = d; n = a & !latch; o3 = m | n & b;", plcAst);
+
+  for (bool fused : { false, true })
+  {
+    std::vector<plc::Operation> instructions;
+    plc::PlcOptimizer optimizer(plcAst, fused ? std::vector<plc::CompileOption>{ plc::CompileOption::FusedOperations } : std::vector<plc::CompileOption>());
+    optimizer.compile(instructions);
+
+    std::vector<uint8_t> avrplc;
+    plc::translateAvr(instructions, avrplc);
+
+    PlcSimulator interpreted(plc::createSimulator(plcAst));
+    PlcSimulator emulated(plc::createSimulator(plcAst));
+    PlcProgram program(interpreted.load(instructions));
+    AvrEmulator emulator(avrplc);
+
+    AvrScanStatistics worstCase(emulator.worstCase());
+    BOOST_CHECK_EQUAL(worstCase.instructions, unsigned(instructions.size()));
+    BOOST_CHECK_EQUAL(worstCase.bytes, unsigned(avrplc.size()));
+    BOOST_CHECK_EQUAL(worstCase.extended, unsigned(avrplc.size() - instructions.size()));
+    BOOST_CHECK_EQUAL(worstCase.maxStackDepth, optimizer.statistics().maxStackDepth);
+
+    std::mt19937 random(5);
+    for (unsigned scan = 0; scan < 2000; scan++)
+    {
+      unsigned input = random() % 6;
+      input = input == 5 ? 70 : input;
+      bool value = (random() & 1) != 0;
+      interpreted.set(PlcSimulator::IOType::Input, input, value);
+      emulated.set(PlcSimulator::IOType::Input, input, value);
+
+      interpreted.clearTriggered();
+      emulated.clearTriggered();
+      interpreted.execute<16>(program);
+      emulator.scan(emulated);
+      BOOST_REQUIRE(interpreted.image() == emulated.image());
+      BOOST_REQUIRE_EQUAL(interpreted.nextExpiry(), emulated.nextExpiry());
+
+      const AvrScanStatistics& statistics = emulator.statistics();
+      BOOST_REQUIRE_EQUAL(statistics.instructions, worstCase.instructions);
+      BOOST_REQUIRE_LE(statistics.cycles, worstCase.cycles);
+      BOOST_REQUIRE_EQUAL(statistics.cycles + (worstCase.triggers - statistics.triggers) * emulator.model().trigger, worstCase.cycles);
+
+      unsigned ticks = random() % 3;
+      BOOST_REQUIRE_EQUAL(interpreted.tick(ticks), emulated.tick(ticks));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(AvrEmulator_Cycles)
+{
+  // a & (a | !b), the input 40 has an extended argument
+  PlcSimulator plcSimulator(41, 0, 0, 0);
+  AvrEmulator emulator({ avrplc::READ_INPUT, avrplc::OPERATION | avrplc::DUP,
+    avrplc::READ_INPUT | avrplc::ARGUMENT_EXTENDED, 40 - avrplc::ARGUMENT_EXTENDED,
+    avrplc::OPERATION | avrplc::OR_NOT, avrplc::OPERATION | avrplc::AND }, 3);
+
+  plcSimulator.set(PlcSimulator::IOType::Input, 0, true);
+  BOOST_CHECK(emulator.scan(plcSimulator));
+  plcSimulator.set(PlcSimulator::IOType::Input, 40, true);
+  BOOST_CHECK(emulator.scan(plcSimulator));
+  plcSimulator.set(PlcSimulator::IOType::Input, 0, false);
+  BOOST_CHECK(!emulator.scan(plcSimulator));
+
+  const AvrCycleModel& model = emulator.model();
+  const AvrScanStatistics& statistics = emulator.statistics();
+  BOOST_CHECK_EQUAL(statistics.instructions, 5u);
+  BOOST_CHECK_EQUAL(statistics.bytes, 6u);
+  BOOST_CHECK_EQUAL(statistics.reads, 2u);
+  BOOST_CHECK_EQUAL(statistics.operations, 3u);
+  BOOST_CHECK_EQUAL(statistics.extended, 1u);
+  BOOST_CHECK_EQUAL(statistics.maxStackDepth, 3u);
+  BOOST_CHECK_EQUAL(statistics.cycles, uint64_t(model.scan + 5 * model.fetch + model.extended + 2 * model.read + model.dup + 2 * model.operation));
+
+  BOOST_CHECK_THROW(AvrEmulator({ avrplc::READ_INPUT, avrplc::OPERATION | avrplc::DUP, avrplc::OPERATION | avrplc::AND }, 1), PlcException);
+  BOOST_CHECK_THROW(AvrEmulator({ avrplc::READ_INPUT | avrplc::ARGUMENT_EXTENDED }), PlcException);
+  BOOST_CHECK_THROW(AvrEmulator({ avrplc::READ_INPUT, avrplc::OPERATION | 6 }), PlcException);
+  BOOST_CHECK_THROW(AvrEmulator({ avrplc::OPERATION | avrplc::AND }), PlcException);
+  BOOST_CHECK_THROW(AvrEmulator({ avrplc::READ_INPUT, avrplc::READ_INPUT }), PlcException);
+
+  AvrEmulator outOfRange({ avrplc::READ_INPUT | avrplc::ARGUMENT_EXTENDED, 20 });
+  BOOST_CHECK_THROW(outOfRange.scan(plcSimulator), PlcException);
+
+  // the flag 300 has a wide argument
+  PlcSimulator wideSimulator(1, 0, 301, 0);
+  AvrEmulator wide({ avrplc::READ_INPUT, avrplc::WRITE_FLAG | avrplc::ARGUMENT_EXTENDED, avrplc::ARGUMENT_WIDE, 0x2c, 0x01 });
+  wideSimulator.set(PlcSimulator::IOType::Input, 0, true);
+  wide.scan(wideSimulator);
+  BOOST_CHECK(wideSimulator.get(PlcSimulator::IOType::Flag, 300));
+  BOOST_CHECK_EQUAL(wide.statistics().wide, 1u);
+  BOOST_CHECK_EQUAL(wide.statistics().cycles, uint64_t(model.scan + 2 * model.fetch + model.extended + model.wide + model.read + model.write));
+  BOOST_CHECK_THROW(AvrEmulator({ avrplc::READ_INPUT | avrplc::ARGUMENT_EXTENDED, avrplc::ARGUMENT_WIDE, 1 }), PlcException);
+}
+
+#endif // PARSER_TESTS
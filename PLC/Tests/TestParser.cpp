@@ -160,4 +160,44 @@ BOOST_AUTO_TEST_CASE(Parser_Integers)
   BOOST_CHECK(parser.next(parserResult).is(ParserResult::Type::Integer, 32767));
 }
 
+BOOST_AUTO_TEST_CASE(Parser_TokenViews)
+{
+  const char *text = "Lamp = Switch_1 & 42";
+  ParserInput<2> parserInput(text);
+  Parser<2,3> parser(parserInput);
+
+  ParserResult parserResult;
+  BOOST_CHECK(parser.next(parserResult).is(ParserResult::Type::Identifier, "Lamp"));
+  BOOST_CHECK(parserResult.text().data() == text);
+
+  parser.push(parserResult);
+  ParserResult pushed;
+  BOOST_CHECK(parser.next(pushed).is(ParserResult::Type::Identifier, "Lamp"));
+  BOOST_CHECK(pushed.text().data() == text);
+
+  BOOST_CHECK(parser.next(parserResult).is(ParserResult::Type::Char, '='));
+  BOOST_CHECK(parser.next(parserResult).is(ParserResult::Type::Identifier, "Switch_1"));
+  BOOST_CHECK(parserResult.text().data() == text + 7);
+  BOOST_CHECK(parser.next(parserResult).is(ParserResult::Type::Char, "&"));
+  BOOST_CHECK(parser.next(parserResult).is(ParserResult::Type::Integer, 42u));
+  BOOST_CHECK(parserResult.text().data() == text + 18);
+}
+
+BOOST_AUTO_TEST_CASE(ParserInput_TokenPushedBack)
+{
+  ParserInput<2> parserInput("ab+");
+  auto identifier = [](char ch) { return isalpha(ch) != 0; };
+
+  char c = parserInput.nextChar();
+  BOOST_CHECK_EQUAL(parserInput.token(c, identifier), "ab");
+
+  // a character not just read is pushed onto the stack, its token is a copy
+  parserInput.pushChar('x');
+  c = parserInput.nextChar();
+  boost::string_view copy(parserInput.token(c, identifier));
+  BOOST_CHECK_EQUAL(copy, "x");
+  BOOST_CHECK_EQUAL(parserInput.nextChar(), '+');
+  BOOST_CHECK_EQUAL(copy, "x");
+}
+
 #endif
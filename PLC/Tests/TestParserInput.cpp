@@ -4,6 +4,8 @@
 #include "../ParserInput.h"
 
 #include <sstream>
+#include <fstream>
+#include <cstdio>
 
 BOOST_AUTO_TEST_CASE(ParserInput_nextChar)
 {
@@ -54,4 +56,46 @@ BOOST_AUTO_TEST_CASE(ParserInput_push)
   BOOST_CHECK_EQUAL(parserInput.nextChar(), '\0');
   BOOST_CHECK_EQUAL(parserInput.nextChar(), '\0');
 }
+
+BOOST_AUTO_TEST_CASE(ParserInput_appendWhile)
+{
+  ParserInput<2> parserInput("ab12 x");
+
+  // a pushed character, which was not read, is taken from the stack first
+  BOOST_CHECK_EQUAL(parserInput.nextChar(), 'a');
+  parserInput.pushChar('z');
+  std::string text;
+  parserInput.appendWhile(text, [](char c) { return isalnum(c) != 0; });
+  BOOST_CHECK_EQUAL(text, "zb12");
+  BOOST_CHECK_EQUAL(parserInput.position(), 4u);
+  BOOST_CHECK_EQUAL(parserInput.nextIgnoreBlank(), 'x');
+
+  text.clear();
+  parserInput.appendWhile(text, [](char c) { return isalnum(c) != 0; });
+  BOOST_CHECK(text.empty());
+  parserInput.pushChar('\0');
+  BOOST_CHECK_EQUAL(parserInput.nextChar(), '\0');
+}
+
+BOOST_AUTO_TEST_CASE(ParserInput_MappedFile)
+{
+  const char *filename = "ParserInput_MappedFile.plc";
+  {
+    std::ofstream out(filename, std::ios::binary);
+    out << "a b";
+  }
+
+  {
+    MappedFile file(filename);
+    BOOST_CHECK_EQUAL(file.size(), 3u);
+
+    ParserInput<2> parserInput(file);
+    BOOST_CHECK_EQUAL(parserInput.nextIgnoreBlank(), 'a');
+    BOOST_CHECK_EQUAL(parserInput.nextIgnoreBlank(), 'b');
+    BOOST_CHECK_EQUAL(parserInput.nextIgnoreBlank(), '\0');
+  }
+
+  std::remove(filename);
+  BOOST_CHECK_THROW(MappedFile file(filename), PlcException);
+}
 #endif
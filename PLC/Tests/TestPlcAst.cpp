@@ -0,0 +1,142 @@
+#ifdef PARSER_TESTS
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcScanSimulator.h"
+#include "../include/PlcFlatExpression.h"
+
+namespace
+{
+  std::vector<std::string> names(const std::vector<const Variable*>& variables)
+  {
+    std::vector<std::string> result;
+    for (const Variable *variable : variables)
+      result.emplace_back(variable->name());
+
+    return result;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PlcAst_EquationOrder)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1; outputs: q=0, r=1; flags: f3=0, f2=1, f1=2, latch=3;"
+    "q = f3 & a; f3 = f2 | b; f2 = f1 & !a; f1 = a | b; r = latch; latch = a | latch & !b;", plcAst);
+
+  std::vector<std::vector<std::string>> cycles;
+  std::vector<std::string> order(names(plcAst.equationOrder(&cycles)));
+
+  std::vector<std::string> expected{ "f1", "f2", "f3", "latch", "q", "r" };
+  BOOST_CHECK_EQUAL_COLLECTIONS(order.begin(), order.end(), expected.begin(), expected.end());
+  BOOST_CHECK(cycles.empty());
+
+  PlcAst::DependencyGraph graph(plcAst.dependencyGraph());
+  BOOST_CHECK_EQUAL(graph.equations.size(), 6u);
+  // latch reads itself, that is no dependency
+  BOOST_CHECK(graph.dependencies[3].empty());
+}
+
+BOOST_AUTO_TEST_CASE(PlcAst_Cycles)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0; outputs: q=0; flags: x=0, y=1, z=2;"
+    "q = y; y = x & a; x = y | z; z = a;", plcAst);
+
+  std::vector<std::vector<std::string>> cycles;
+  std::vector<std::string> order(names(plcAst.equationOrder(&cycles)));
+
+  std::vector<std::string> expected{ "z", "x", "y", "q" };
+  BOOST_CHECK_EQUAL_COLLECTIONS(order.begin(), order.end(), expected.begin(), expected.end());
+
+  BOOST_REQUIRE_EQUAL(cycles.size(), 1u);
+  std::vector<std::string> cycle{ "x", "y" };
+  BOOST_CHECK_EQUAL_COLLECTIONS(cycles[0].begin(), cycles[0].end(), cycle.begin(), cycle.end());
+}
+
+BOOST_AUTO_TEST_CASE(PlcAst_LongChain)
+{
+  // each flag reads the one after it, the search follows the whole chain from f0
+  const unsigned n = 200000;
+  std::string declarations("inputs: a=0; flags: ");
+  std::string equations;
+  for (unsigned i = 0; i < n; i++)
+  {
+    declarations += (i ? ", f" : "f") + std::to_string(i) + "=" + std::to_string(i);
+    equations += "f" + std::to_string(i) + " = " + (i + 1 < n ? "f" + std::to_string(i + 1) : std::string("a")) + ";";
+  }
+
+  PlcAst plcAst;
+  plcParse((declarations + ";" + equations).c_str(), plcAst);
+
+  std::vector<std::vector<std::string>> cycles;
+  std::vector<const Variable*> order(plcAst.equationOrder(&cycles));
+  BOOST_REQUIRE_EQUAL(order.size(), n);
+  BOOST_CHECK_EQUAL(order.front()->name(), "f" + std::to_string(n - 1));
+  BOOST_CHECK_EQUAL(order.back()->name(), "f0");
+  BOOST_CHECK(cycles.empty());
+}
+
+BOOST_AUTO_TEST_CASE(PlcAst_SingleScan)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0; outputs: q=0; flags: f9=0, f8=1, f7=2, f6=3;"
+    "q = f6; f6 = f7; f7 = f8; f8 = f9; f9 = a;", plcAst);
+
+  PlcScanSimulator scanSimulator(plcAst);
+  scanSimulator.setInput(0, true);
+  scanSimulator.scan();
+
+  BOOST_CHECK(scanSimulator.simulator().get(PlcSimulator::IOType::Output, 0));
+}
+
+BOOST_AUTO_TEST_CASE(PlcAst_ResolveShared)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3; outputs: q=0; flags: f0=0, f1=1;"
+    "f0 = a & b; f1 = f0 | c; q = (f1 & d) | (!f1 & a) | (c & d);", plcAst);
+
+  const plc::Expression& f1 = plcAst.resolved(plcAst.getVariable("f1"));
+  BOOST_CHECK(&plcAst.resolved(plcAst.getVariable("f1")) == &f1);
+
+  size_t arenaSize = plcAst.arena().size();
+  const plc::Expression q(plcAst.resolveDependencies("q"));
+  // only the two sub expressions reading f1 are copied
+  BOOST_CHECK_EQUAL(plcAst.arena().size(), arenaSize + 2);
+
+  BOOST_REQUIRE_EQUAL(q.terms().size(), 3u);
+  const plc::Expression *parsed = plcAst.getVariable("q").expression();
+  BOOST_CHECK(q.terms()[0].expression()->terms()[0].expression() == &f1);
+  BOOST_CHECK(q.terms()[1].expression()->terms()[0].expression() == &f1);
+  BOOST_CHECK(q.terms()[1].expression()->terms()[0].unary() == plc::Term::Unary::Not);
+  BOOST_CHECK(q.terms()[2].expression() == parsed->terms()[2].expression());
+
+  // the terms of q are shared, a copy of it refers to the same nodes
+  const plc::Expression copy(q);
+  BOOST_REQUIRE_EQUAL(copy.terms().size(), 3u);
+  for (unsigned i = 0; i < 3; i++)
+  {
+    BOOST_CHECK(copy.terms()[i].expression() == q.terms()[i].expression());
+    BOOST_CHECK(copy.terms()[i].unary() == q.terms()[i].unary());
+  }
+  BOOST_CHECK(copy.terms()[1].expression()->terms()[0].expression() == &f1);
+
+  plc::Term term(copy.terms()[0]);
+  BOOST_CHECK(term.expression() == q.terms()[0].expression());
+  BOOST_CHECK_EQUAL(plcAst.arena().size(), arenaSize + 2);
+
+  // f0 in the inserted f1 is read, not inserted
+  plc::FlatExpression flat(q);
+  for (unsigned row = 0; row < 16; row++)
+  {
+    bool in[4] = { (row & 1) != 0, (row & 2) != 0, (row & 4) != 0, (row & 8) != 0 };
+    bool value = flat.evaluate([&](unsigned id)
+    {
+      return id == plcAst.id("f0") ? in[0] && in[1] : in[plcAst.variable(id).index()];
+    });
+
+    bool f1Value = (in[0] && in[1]) || in[2];
+    BOOST_CHECK_EQUAL(value, (f1Value && in[3]) || (!f1Value && in[0]) || (in[2] && in[3]));
+  }
+}
+
+#endif // PARSER_TESTS
@@ -0,0 +1,125 @@
+#ifdef PARSER_TESTS
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+#include <boost/test/unit_test.hpp>
+#include "../include/PlcThreadPool.h"
+#include "../include/PlcBatch.h"
+
+namespace
+{
+  std::string readFile(const std::string& filename)
+  {
+    std::ifstream in(filename, std::ios::binary);
+    std::ostringstream text;
+    text << in.rdbuf();
+
+    return text.str();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PlcThreadPool_Tasks)
+{
+  std::atomic<unsigned> count(0);
+  {
+    PlcThreadPool pool(4);
+    BOOST_CHECK_EQUAL(pool.size(), 4u);
+
+    // the tasks of a task go to the queue of its worker, the others steal them
+    for (unsigned i = 0; i < 8; i++)
+      pool.submit([&pool, &count]()
+      {
+        for (unsigned j = 0; j < 100; j++)
+          pool.submit([&count]() { count++; });
+      });
+
+    pool.wait();
+    BOOST_CHECK_EQUAL(count.load(), 800u);
+
+    pool.submit([]() { throw PlcException("task %d failed", 7); });
+    pool.submit([&count]() { count++; });
+    BOOST_CHECK_THROW(pool.wait(), PlcException);
+    BOOST_CHECK_EQUAL(count.load(), 801u);
+
+    // the exception is reported once
+    pool.wait();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PlcBatch_Programs)
+{
+  const char *source =
+    "inputs: a = 0, b = 1, c = 2;\n"
+    "outputs: q = 0, r = 1;\n"
+    "flags: f = 0;\n"
+    "f = a & b | c;\n"
+    "q = f & !a | b & c;\n"
+    "r = !f | a & (b | c);\n";
+
+  std::vector<std::string> names;
+  for (unsigned i = 0; i < 6; i++)
+  {
+    names.emplace_back("PlcBatch_" + std::to_string(i) + ".plc");
+    std::ofstream out(names.back(), std::ios::binary);
+    out << (i == 3 ? "inputs: a = 0; outputs: q = 0; q = a & ;" : source);
+  }
+  {
+    std::ofstream out("PlcBatch_list.txt");
+    out << names[0] << '\n' << names[1] << "\r\n\n";
+  }
+
+  std::vector<std::string> programs(plc::expandPrograms({ "PlcBatch_?.plc" }));
+  BOOST_CHECK_EQUAL(programs.size(), names.size());
+  BOOST_CHECK_EQUAL(plc::expandPrograms({ "@PlcBatch_list.txt", names[2] }).size(), 3u);
+  BOOST_CHECK_THROW(plc::expandPrograms({ "PlcBatch_none*.plc" }), PlcException);
+
+  BOOST_CHECK_EQUAL(plc::batchOutput("dir/name.plc", ".bin", plc::BatchOptions()), "dir/name.bin");
+  plc::BatchOptions options;
+  options.outputDirectory = "out";
+  BOOST_CHECK_EQUAL(plc::batchOutput("dir/name.plc", ".svg", options), "out/name.svg");
+
+  options = plc::BatchOptions();
+  options.threads = 3;
+  options.compileOptions = { plc::CompileOption::CommonSubexpressions };
+  options.svgOptions = { SVGOption::NotInteractive };
+
+  plc::BatchSummary summary;
+  std::vector<plc::BatchResult> results(plc::runBatch(names, options, &summary));
+  BOOST_REQUIRE_EQUAL(results.size(), names.size());
+  BOOST_CHECK_EQUAL(summary.programs, 6u);
+  BOOST_CHECK_EQUAL(summary.failed, 1u);
+  BOOST_CHECK_EQUAL(summary.threads, 3u);
+  BOOST_CHECK(!results[3].error.empty());
+
+  // each program on another thread gives the output of one program alone
+  PlcAst plcAst;
+  plcParse(source, plcAst);
+  std::ostringstream svg;
+  convert2svg(plcAst, svg, { SVGOption::NotInteractive });
+
+  for (unsigned i = 0; i < names.size(); i++)
+  {
+    BOOST_CHECK_EQUAL(results[i].program, names[i]);
+    if (i == 3)
+      continue;
+
+    BOOST_CHECK(results[i].error.empty());
+    BOOST_CHECK(results[i].bytes > 0);
+    BOOST_CHECK_EQUAL(results[i].svgBytes, svg.str().size());
+    BOOST_CHECK(readFile(plc::batchOutput(names[i], ".svg", options)) == svg.str());
+    BOOST_CHECK_EQUAL(readFile(plc::batchOutput(names[i], ".bin", options)).size(), results[i].bytes);
+  }
+
+  for (const std::string& name : names)
+  {
+    std::remove(name.c_str());
+    std::remove(plc::batchOutput(name, ".bin", options).c_str());
+    std::remove(plc::batchOutput(name, ".svg", options).c_str());
+  }
+  std::remove("PlcBatch_list.txt");
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifdef PARSER_TESTS
+
+#include <random>
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcEventSimulator.h"
+
+namespace
+{
+  const char *PROGRAM = "inputs: a=0, b=1, c=2, d=3, e=4, g=5;"
+    "outputs: o0=0, o1=1, o2=2, o3=3; flags: f0=0, f1=1, latch=2; monoflops: m(4s)=0;"
+    "f0 = a & b; f1 = f0 | c; o0 = f1 & !d; o1 = !f0 & e;"
+    "latch = e | latch & !g; o2 = latch; m = d; o3 = m | a;";
+}
+
+BOOST_AUTO_TEST_CASE(PlcEventSimulator_Fanout)
+{
+  PlcAst plcAst;
+  plcParse(PROGRAM, plcAst);
+
+  PlcEventSimulator eventSimulator(plcAst);
+  BOOST_CHECK_EQUAL(eventSimulator.equations(), 8u);
+  BOOST_CHECK(eventSimulator.simulator().get(PlcSimulator::IOType::Output, 1) == false);
+
+  // g is only read by latch, which does not change
+  uint64_t evaluations = eventSimulator.evaluations();
+  eventSimulator.setInput(5, true);
+  BOOST_CHECK_EQUAL(eventSimulator.evaluations() - evaluations, 1u);
+
+  // e changes o1 and latch, which changes o2 and reads itself once more
+  evaluations = eventSimulator.evaluations();
+  eventSimulator.setInput(4, true);
+  BOOST_CHECK_EQUAL(eventSimulator.evaluations() - evaluations, 4u);
+  BOOST_CHECK(eventSimulator.simulator().get(PlcSimulator::IOType::Output, 1));
+  BOOST_CHECK(eventSimulator.simulator().get(PlcSimulator::IOType::Output, 2));
+
+  // unchanged value, nothing to do
+  evaluations = eventSimulator.evaluations();
+  eventSimulator.setInput(4, true);
+  BOOST_CHECK_EQUAL(eventSimulator.evaluations(), evaluations);
+}
+
+BOOST_AUTO_TEST_CASE(PlcEventSimulator_Monoflop)
+{
+  PlcAst plcAst;
+  plcParse(PROGRAM, plcAst);
+
+  PlcEventSimulator eventSimulator(plcAst);
+
+  eventSimulator.setInput(3, true);
+  eventSimulator.setInput(3, false);
+  BOOST_CHECK(eventSimulator.simulator().get(PlcSimulator::IOType::Output, 3));
+
+  eventSimulator.tick(1);
+  BOOST_CHECK(eventSimulator.simulator().get(PlcSimulator::IOType::Output, 3));
+  eventSimulator.tick(1);
+  BOOST_CHECK(!eventSimulator.simulator().get(PlcSimulator::IOType::Output, 3));
+
+  // held trigger keeps the monoflop running
+  eventSimulator.setInput(3, true);
+  eventSimulator.tick(100);
+  BOOST_CHECK(eventSimulator.simulator().get(PlcSimulator::IOType::Output, 3));
+}
+
+BOOST_AUTO_TEST_CASE(PlcEventSimulator_ScanEquivalence)
+{
+  PlcAst plcAst;
+  plcParse(PROGRAM, plcAst);
+
+  PlcEventSimulator eventSimulator(plcAst);
+  PlcScanSimulator scanSimulator(plcAst);
+
+  std::mt19937 random(4711);
+  for (unsigned i = 0; i < 500; i++)
+  {
+    unsigned input = random() % 6;
+    bool value = (random() & 1) != 0;
+
+    eventSimulator.setInput(input, value);
+    scanSimulator.setInput(input, value);
+    BOOST_REQUIRE(scanSimulator.settle());
+
+    BOOST_REQUIRE(eventSimulator.simulator().image() == scanSimulator.simulator().image());
+  }
+}
+
+#endif // PARSER_TESTS
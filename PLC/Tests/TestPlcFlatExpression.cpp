@@ -0,0 +1,127 @@
+#ifdef PARSER_TESTS
+
+#include <random>
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcScanSimulator.h"
+#include "../include/PlcFlatExpression.h"
+
+BOOST_AUTO_TEST_CASE(PlcFlatExpression_Lower)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2; outputs: q=0; q = a & !(b | c);", plcAst);
+
+  plc::FlatExpression flat(*plcAst.getVariable("q").expression());
+
+  // a, b, c, (b | c), the root
+  BOOST_REQUIRE_EQUAL(flat.size(), 5u);
+  BOOST_CHECK(flat.kind(0) == plc::FlatExpression::Kind::Variable);
+  BOOST_CHECK_EQUAL(flat.variable(0), plcAst.id("a"));
+  BOOST_CHECK_EQUAL(flat.variable(1), plcAst.id("b"));
+  BOOST_CHECK_EQUAL(flat.variable(2), plcAst.id("c"));
+
+  BOOST_CHECK(flat.kind(3) == plc::FlatExpression::Kind::Expression);
+  BOOST_CHECK(flat.op(3) == plc::Expression::Operator::Or);
+  BOOST_CHECK(flat.negated(3));
+  BOOST_CHECK(flat.variable(3) == plc::FlatExpression::NO_VARIABLE);
+  std::vector<unsigned> orChildren(flat.childrenBegin(3), flat.childrenEnd(3));
+  std::vector<unsigned> expected{ 1, 2 };
+  BOOST_CHECK_EQUAL_COLLECTIONS(orChildren.begin(), orChildren.end(), expected.begin(), expected.end());
+
+  BOOST_CHECK_EQUAL(flat.root(), 4u);
+  BOOST_CHECK(flat.op(flat.root()) == plc::Expression::Operator::And);
+  BOOST_CHECK(!flat.negated(flat.root()));
+  BOOST_CHECK_EQUAL(flat.variable(flat.root()), plcAst.id("q"));
+  BOOST_CHECK_EQUAL(flat.id(flat.root()), plcAst.getVariable("q").expression()->id());
+  std::vector<unsigned> andChildren(flat.childrenBegin(4), flat.childrenEnd(4));
+  expected = { 0, 3 };
+  BOOST_CHECK_EQUAL_COLLECTIONS(andChildren.begin(), andChildren.end(), expected.begin(), expected.end());
+
+  for (unsigned row = 0; row < 8; row++)
+  {
+    bool a = (row & 1) != 0, b = (row & 2) != 0, c = (row & 4) != 0;
+    bool value = flat.evaluate([&](unsigned id) { return id == plcAst.id("a") ? a : id == plcAst.id("b") ? b : c; });
+    BOOST_CHECK_EQUAL(value, a && !(b || c));
+  }
+
+  // an expression outside the arena gets an id after the last one of the arena
+  plc::Expression outside(plc::Expression::Operator::Or, plcAst.getVariable("q").expression()->terms());
+  plc::FlatExpression flatOutside(outside);
+  BOOST_CHECK(flatOutside.id(flatOutside.root()) == plc::Expression::NO_ID);
+
+  unsigned lastId = plcAst.arena().lastId();
+  flatOutside.assignIds(lastId);
+  BOOST_CHECK_EQUAL(lastId, plcAst.arena().lastId() + 1);
+  BOOST_CHECK_EQUAL(flatOutside.id(flatOutside.root()), lastId);
+  BOOST_CHECK_EQUAL(flatOutside.id(3), flat.id(3));
+}
+
+BOOST_AUTO_TEST_CASE(PlcFlatExpression_Passes)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3, e=4, g=70;"
+    "outputs: o0=0, o1=1, o2=2, o3=3, o4=4, o5=5; flags: f0=0, f1=1, latch=2;"
+    "f0 = a & b; f1 = f0 | c & !g; o0 = f1 & !d | (a | b) & (c | d & (e | !g));"
+    "o1 = !f0 & e | !(a | c); latch = e | latch & !g; o2 = latch; o3 = !(!(a & b) | !(c & !(d | e)));"
+    "o4 = a & b & c & d & e; o5 = a | (b & c) | d | (c & (d | e)) | !(e & g) | b;", plcAst);
+
+  std::vector<plc::Operation> instructions;
+  plc::compile(plcAst, instructions);
+  PlcSimulator equationSimulator(plc::createSimulator(plcAst));
+
+  std::vector<plc::Operation> fromTree;
+  for (const Variable *variable : plcAst.equationOrder())
+  {
+    const plc::Expression& expression = *variable->expression();
+    plc::FlatExpression flat(expression);
+
+    BOOST_CHECK_EQUAL(flat.countLevels(), expression.countLevels());
+
+    std::vector<unsigned> flatInputs, treeInputs;
+    flat.countInputs(flatInputs);
+    expression.countInputs(treeInputs);
+    BOOST_CHECK(flatInputs == treeInputs);
+
+    std::vector<plc::Operation> equation;
+    plc::compile(plcAst, expression, [&equation](plc::Instruction instruction, unsigned argument)
+    {
+      equation.emplace_back(plc::Operation{ instruction, argument });
+    });
+
+    // the depth the compiled equation actually needs
+    BOOST_CHECK_EQUAL(flat.stackDepths()[flat.root()], equationSimulator.load(equation).maxStackDepth());
+
+    fromTree.insert(fromTree.end(), equation.begin(), equation.end());
+    fromTree.emplace_back(plc::Operation{ plc::writeInstruction(variable->type()), variable->index() });
+  }
+
+  BOOST_REQUIRE_EQUAL(instructions.size(), fromTree.size());
+  for (unsigned i = 0; i < instructions.size(); i++)
+  {
+    BOOST_CHECK(instructions[i].instruction == fromTree[i].instruction);
+    BOOST_CHECK_EQUAL(instructions[i].argument, fromTree[i].argument);
+  }
+
+  // after a scan each equation holds on the process image
+  PlcSimulator simulator(plc::createSimulator(plcAst));
+  PlcProgram program(simulator.load(instructions));
+  std::vector<plc::FlatExpression> equations;
+  std::vector<const Variable*> variables(plcAst.equationOrder());
+  for (const Variable *variable : variables)
+    equations.emplace_back(*variable->expression());
+
+  std::mt19937 random(7);
+  for (unsigned scan = 0; scan < 500; scan++)
+  {
+    unsigned input = random() % 6;
+    simulator.set(PlcSimulator::IOType::Input, input == 5 ? 70 : input, (random() & 1) != 0);
+    simulator.execute<16>(program);
+
+    for (unsigned i = 0; i < variables.size(); i++)
+      BOOST_REQUIRE_EQUAL(equations[i].evaluate(plcAst, simulator),
+        simulator.get(plc::FlatExpression::ioType(variables[i]->type()), variables[i]->index()));
+  }
+}
+
+#endif
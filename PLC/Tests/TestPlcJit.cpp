@@ -0,0 +1,80 @@
+#ifdef PARSER_TESTS
+
+#include <random>
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcOptimizer.h"
+#include "../include/PlcScanSimulator.h"
+#include "../include/PlcJit.h"
+
+namespace
+{
+  const char *PROGRAM = "inputs: a=0, b=1, c=2, d=3, e=4, g=70;"
+    "outputs: o0=0, o1=1, o2=2, o3=65; flags: f0=0, f1=1, latch=2; monoflops: m(4s)=0, n=1;"
+    "f0 = a & b; f1 = f0 | c & !g; o0 = f1 & !d; o1 = !f0 & e | !(a | c);"
+    "latch = e | latch & !g; o2 = latch; m = d; n = a & !latch; o3 = m | n & b;";
+}
+
+BOOST_AUTO_TEST_CASE(PlcJit_Equivalence)
+{
+  PlcAst plcAst;
+  plcParse(PROGRAM, plcAst);
+
+  for (bool fused : { false, true })
+  {
+    std::vector<plc::Operation> instructions;
+    plc::PlcOptimizer optimizer(plcAst, fused ? std::vector<plc::CompileOption>{ plc::CompileOption::FusedOperations } : std::vector<plc::CompileOption>());
+    optimizer.compile(instructions);
+
+    PlcSimulator interpreted(plc::createSimulator(plcAst));
+    PlcSimulator native(plc::createSimulator(plcAst));
+    PlcProgram program(interpreted.load(instructions));
+    PlcJitProgram jitProgram(native.load(instructions));
+
+#if defined(PLC_JIT)
+    BOOST_CHECK(jitProgram.native());
+    BOOST_CHECK_GT(jitProgram.codeSize(), instructions.size());
+#endif
+
+    std::mt19937 random(3);
+    for (unsigned scan = 0; scan < 2000; scan++)
+    {
+      unsigned input = random() % 6;
+      input = input == 5 ? 70 : input;
+      bool value = (random() & 1) != 0;
+      interpreted.set(PlcSimulator::IOType::Input, input, value);
+      native.set(PlcSimulator::IOType::Input, input, value);
+
+      interpreted.clearTriggered();
+      native.clearTriggered();
+      interpreted.execute<16>(program);
+      native.execute<16>(jitProgram);
+      BOOST_REQUIRE(interpreted.image() == native.image());
+      BOOST_REQUIRE_EQUAL(interpreted.nextExpiry(), native.nextExpiry());
+
+      unsigned ticks = random() % 3;
+      BOOST_REQUIRE_EQUAL(interpreted.tick(ticks), native.tick(ticks));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PlcJit_Result)
+{
+  PlcSimulator plcSimulator(2, 0, 0, 0);
+  PlcJitProgram jitProgram(plcSimulator.load({ { plc::Instruction::ReadInput, 0 }, { plc::Instruction::ReadInput, 1 },
+    { plc::Instruction::OperationNot, 0 }, { plc::Instruction::OperationAnd, 0 } }));
+
+  plcSimulator.set(PlcSimulator::IOType::Input, 0, true);
+  BOOST_CHECK(plcSimulator.execute<2>(jitProgram));
+  plcSimulator.set(PlcSimulator::IOType::Input, 1, true);
+  BOOST_CHECK(!plcSimulator.execute<2>(jitProgram));
+
+  BOOST_CHECK_THROW(plcSimulator.execute<1>(jitProgram), PlcException);
+
+  // custom IOs are only seen by the interpreter
+  plcSimulator.setIO(PlcSimulator::IOType::Input, 1, std::unique_ptr<IO>(new IO()));
+  BOOST_CHECK(plcSimulator.execute<2>(jitProgram));
+}
+
+#endif // PARSER_TESTS
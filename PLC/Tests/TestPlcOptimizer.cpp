@@ -0,0 +1,376 @@
+#ifdef PARSER_TESTS
+
+#include <random>
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcOptimizer.h"
+#include "../include/PlcTruthTable.h"
+#include "../include/AvrEmulator.h"
+
+namespace
+{
+  /// <summary>
+  /// Runs the plain and the optimized program for some scans with random inputs,
+  /// all declared outputs and flags have to match after each scan. Constant inputs keep their value,
+  /// remapped flags are compared at their new index.
+  /// </summary>
+  void checkEquivalence(const PlcAst& plcAst, const std::vector<plc::Operation>& optimized, const plc::CompileStatistics& statistics)
+  {
+    std::vector<plc::Operation> plain;
+    plc::compile(plcAst, plain);
+
+    unsigned inputs = plcAst.maxVariableIndexOfType(Variable::Type::Input) + 1;
+    unsigned outputs = plcAst.maxVariableIndexOfType(Variable::Type::Output) + 1;
+    unsigned flags = statistics.firstFlag + statistics.flags;
+
+    PlcSimulator plainSimulator(inputs, outputs, flags, 0);
+    PlcSimulator optimizedSimulator(inputs, outputs, flags, 0);
+    PlcProgram plainProgram(plainSimulator.load(plain));
+    PlcProgram optimizedProgram(optimizedSimulator.load(optimized));
+
+    std::vector<int> constants(inputs, -1);
+    for (auto it = plcAst.constants().begin(); it != plcAst.constants().end(); it++)
+      constants[plcAst.getVariable(it->first).index()] = it->second ? 1 : 0;
+
+    std::mt19937 random(7);
+    for (unsigned scan = 0; scan < 500; scan++)
+    {
+      for (unsigned i = 0; i < inputs; i++)
+      {
+        bool value = constants[i] < 0 ? (random() & 1) != 0 : constants[i] != 0;
+        plainSimulator.set(PlcSimulator::IOType::Input, i, value);
+        optimizedSimulator.set(PlcSimulator::IOType::Input, i, value);
+      }
+
+      plainSimulator.execute<16>(plainProgram);
+      optimizedSimulator.execute<16>(optimizedProgram);
+
+      for (unsigned i = 0; i < outputs; i++)
+        BOOST_REQUIRE_EQUAL(plainSimulator.get(PlcSimulator::IOType::Output, i), optimizedSimulator.get(PlcSimulator::IOType::Output, i));
+      for (unsigned i = 0; i < statistics.firstFlag; i++)
+        if (statistics.flagMapping.empty())
+          BOOST_REQUIRE_EQUAL(plainSimulator.get(PlcSimulator::IOType::Flag, i), optimizedSimulator.get(PlcSimulator::IOType::Flag, i));
+        else if (i < statistics.flagMapping.size() && statistics.flagMapping[i] != ~0u)
+          BOOST_REQUIRE_EQUAL(plainSimulator.get(PlcSimulator::IOType::Flag, i), optimizedSimulator.get(PlcSimulator::IOType::Flag, statistics.flagMapping[i]));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_CommonSubexpressions)
+{
+  PlcAst plcAst;
+  plcParse("inputs: door=0, alarm=1, a=2, b=3, c=4; outputs: q0=0, q1=1, q2=2, q3=3; flags: f=0;"
+    "q0 = door & !alarm & a; q1 = (!alarm & door) | b; q2 = c & (door & !alarm);"
+    "f = !(a | b | c); q3 = (c | a | b) | door;", plcAst);
+
+  std::vector<plc::Operation> instructions;
+  plc::PlcOptimizer optimizer(plcAst, { plc::CompileOption::CommonSubexpressions });
+  optimizer.compile(instructions);
+
+  const plc::CompileStatistics& statistics = optimizer.statistics();
+  BOOST_CHECK_EQUAL(statistics.firstFlag, 1u);
+  BOOST_CHECK_EQUAL(statistics.sharedExpressions, 2u);
+  BOOST_CHECK_EQUAL(statistics.flags, 2u);
+  BOOST_CHECK_EQUAL(statistics.instructions, unsigned(instructions.size()));
+  BOOST_CHECK_GT(statistics.instructionsSaved(), 0);
+  BOOST_CHECK_GT(statistics.bytesSaved(), 0);
+
+  checkEquivalence(plcAst, instructions, statistics);
+
+  plc::PlcOptimizer plain(plcAst, {});
+  plain.compile(instructions);
+  BOOST_CHECK_EQUAL(plain.statistics().instructionsSaved(), 0);
+  BOOST_CHECK_EQUAL(plain.statistics().flags, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_Invalidate)
+{
+  // the latch writes f between the two occurrences of f & a & !b
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2; outputs: q=0, r=1; flags: f=0;"
+    "f = f & a & !b | c; q = f & a & !b; r = (f & !b & a) | c;", plcAst);
+
+  std::vector<plc::Operation> instructions;
+  plc::PlcOptimizer optimizer(plcAst, { plc::CompileOption::CommonSubexpressions });
+  optimizer.compile(instructions);
+
+  BOOST_CHECK_EQUAL(optimizer.statistics().sharedExpressions, 1u);
+  checkEquivalence(plcAst, instructions, optimizer.statistics());
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_FlagReuse)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3, e=4; outputs: q0=0, q1=1, q2=2, q3=3;"
+    "q0 = a & !b & c; q1 = (a & !b & c) | d; q2 = !d & (e | !a) & b; q3 = (b & !d & (!a | e)) | c;", plcAst);
+
+  std::vector<plc::Operation> instructions;
+  plc::PlcOptimizer optimizer(plcAst, std::vector<plc::CompileOption>{ plc::CompileOption::CommonSubexpressions });
+  optimizer.compile(instructions);
+
+  BOOST_CHECK_EQUAL(optimizer.statistics().firstFlag, 0u);
+  BOOST_CHECK_EQUAL(optimizer.statistics().sharedExpressions, 2u);
+  BOOST_CHECK_EQUAL(optimizer.statistics().flags, 1u);
+  checkEquivalence(plcAst, instructions, optimizer.statistics());
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_Minimize)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2; outputs: q0=0, q1=1, q2=2, q3=3;"
+    "q0 = a | a & b; q1 = !(!a | !b) | a & b & c; q2 = a & b | a & !b | !a & b & c; q3 = !a & !b | !a & !c;", plcAst);
+
+  plc::Minimizer minimizer(plcAst);
+
+  std::unique_ptr<plc::Expression> expression;
+  std::vector<unsigned> sizes;
+  for (const char *name : { "q0", "q1", "q2", "q3" })
+  {
+    expression = minimizer.minimize(*plcAst.getVariable(name).expression());
+    BOOST_REQUIRE(expression);
+
+    unsigned size = 0;
+    plc::compile(plcAst, *expression, [&size](plc::Instruction, unsigned) { size++; });
+    sizes.push_back(size);
+  }
+
+  // a, a & b, a | b & c, !(a | b & c)
+  std::vector<unsigned> expected{ 1, 3, 5, 6 };
+  BOOST_CHECK_EQUAL_COLLECTIONS(sizes.begin(), sizes.end(), expected.begin(), expected.end());
+
+  // already minimal
+  BOOST_CHECK(!minimizer.minimize(*expression));
+
+  std::vector<plc::Operation> instructions;
+  plc::PlcOptimizer optimizer(plcAst, { plc::CompileOption::Minimize, plc::CompileOption::CommonSubexpressions });
+  optimizer.compile(instructions);
+  BOOST_CHECK_EQUAL(optimizer.statistics().minimizedEquations, 4u);
+  BOOST_CHECK_GT(optimizer.statistics().bytesSaved(), 0);
+  checkEquivalence(plcAst, instructions, optimizer.statistics());
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_MinimizeLarge)
+{
+  PlcAst plcAst;
+  plcParse("inputs: x0=0, x1=1, x2=2, x3=3, x4=4, x5=5, x6=6, x7=7, x8=8, x9=9, x10=10, x11=11, x12=12, x13=13, x14=14, x15=15, x16=16, x17=17, x18=18, x19=19, x20=20, x21=21, x22=22, x23=23, x24=24, x25=25; outputs: q=0; q = x0 | x1 | x2 | x3 | x4 | x5 | x6 | x7 | x8 | x9 | x10 | x11 | x12 | x13 | x14 | x15 | x16 | x17 | x18 | x19 | x20 | x21 | x22 | x23 | x24 | x25 | x0 & x1 | (x2 | x3) & x4;", plcAst);
+
+  // 26 variables: only the absorption of the algebraic rewrites, which needs no check
+  std::vector<plc::Operation> instructions;
+  plc::PlcOptimizer optimizer(plcAst, { plc::CompileOption::Minimize });
+  optimizer.compile(instructions);
+  BOOST_CHECK_EQUAL(optimizer.statistics().minimizedEquations, 1u);
+  BOOST_CHECK_EQUAL(optimizer.statistics().instructions, 26u + 25u + 1u);
+  checkEquivalence(plcAst, instructions, optimizer.statistics());
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_StackDepth)
+{
+  // left to right q needs 5 stack entries, deepest first 2
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3, e=4; outputs: q=0, r=1;"
+    "q = a & (b | (c & (d | e))); r = (a | b) & (c | d) & e;", plcAst);
+
+  BOOST_CHECK_EQUAL(plc::stackDepth(*plcAst.getVariable("q").expression()), 2u);
+  BOOST_CHECK_EQUAL(plc::stackDepth(*plcAst.getVariable("r").expression()), 3u);
+
+  std::vector<plc::Operation> instructions;
+  plc::compile(plcAst, *plcAst.getVariable("q").expression(), [&instructions](plc::Instruction instruction, unsigned argument)
+  {
+    instructions.emplace_back(plc::Operation{ instruction, argument });
+  });
+  BOOST_CHECK(instructions.front().instruction == plc::Instruction::ReadInput && instructions.front().argument == 3);
+
+  plc::PlcOptimizer optimizer(plcAst, {});
+  optimizer.compile(instructions);
+
+  const plc::CompileStatistics& statistics = optimizer.statistics();
+  BOOST_REQUIRE_EQUAL(statistics.stackDepths.size(), 2u);
+  BOOST_CHECK_EQUAL(statistics.stackDepths[0].second, 2u);
+  BOOST_CHECK_EQUAL(statistics.stackDepths[1].second, 3u);
+  BOOST_CHECK_EQUAL(statistics.maxStackDepth, 3u);
+
+  PlcSimulator plcSimulator(5, 2, 0, 0);
+  PlcProgram program(plcSimulator.load(instructions));
+  BOOST_CHECK_EQUAL(program.maxStackDepth(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_StackDepthManyTerms)
+{
+  // each term is combined with the ones before, the fourth one finds one value, not three
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3, e=4; outputs: q=0, r=1;"
+    "q = a & b & c & d & e; r = a | (b & c) | d | (c & (d | e)) | e;", plcAst);
+
+  BOOST_CHECK_EQUAL(plc::stackDepth(*plcAst.getVariable("q").expression()), 2u);
+  BOOST_CHECK_EQUAL(plc::stackDepth(*plcAst.getVariable("r").expression()), 3u);
+
+  std::vector<plc::Operation> instructions;
+  plc::compile(plcAst, *plcAst.getVariable("q").expression(), [&instructions](plc::Instruction instruction, unsigned argument)
+  {
+    instructions.emplace_back(plc::Operation{ instruction, argument });
+  });
+
+  PlcSimulator plcSimulator(5, 2, 0, 0);
+  BOOST_CHECK_EQUAL(plcSimulator.load(instructions).maxStackDepth(), 2u);
+
+  plc::PlcOptimizer optimizer(plcAst, {});
+  optimizer.compile(instructions);
+  BOOST_CHECK_EQUAL(optimizer.statistics().maxStackDepth, plcSimulator.load(instructions).maxStackDepth());
+  BOOST_CHECK_EQUAL(optimizer.statistics().maxStackDepth, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_Peephole)
+{
+  using plc::Instruction;
+
+  std::vector<plc::Operation> instructions{
+    { Instruction::ReadInput, 0 }, { Instruction::ReadInput, 1 }, { Instruction::OperationNot, 0 }, { Instruction::OperationNot, 0 },
+    { Instruction::ReadFlag, 2 }, { Instruction::WriteFlag, 2 }, { Instruction::OperationNot, 0 }, { Instruction::OperationAnd, 0 },
+    { Instruction::WriteFlag, 0 }, { Instruction::ReadFlag, 0 }, { Instruction::ReadMonoflop, 0 }, { Instruction::WriteMonoflop, 0 },
+    { Instruction::WriteOuput, 0 } };
+
+  std::vector<plc::Operation> plain(instructions);
+  BOOST_CHECK_EQUAL(plc::peephole(plain, false), 2u);
+  BOOST_CHECK_EQUAL(plain.size(), 9u);
+
+  BOOST_CHECK_EQUAL(plc::peephole(instructions, true), 4u);
+  std::vector<Instruction> expected{ Instruction::ReadInput, Instruction::ReadInput, Instruction::OperationAndNot,
+    Instruction::OperationDup, Instruction::WriteFlag, Instruction::ReadMonoflop, Instruction::WriteMonoflop, Instruction::WriteOuput };
+  BOOST_REQUIRE_EQUAL(instructions.size(), expected.size());
+  for (unsigned i = 0; i < expected.size(); i++)
+    BOOST_CHECK(instructions[i].instruction == expected[i]);
+
+  PlcSimulator plcSimulator(2, 1, 3, 1);
+  PlcProgram program(plcSimulator.load(instructions));
+  BOOST_CHECK_EQUAL(program.maxStackDepth(), 2u);
+  plcSimulator.set(PlcSimulator::IOType::Input, 0, true);
+  plcSimulator.execute<4>(program);
+  BOOST_CHECK(plcSimulator.get(PlcSimulator::IOType::Flag, 0));
+  BOOST_CHECK(plcSimulator.get(PlcSimulator::IOType::Output, 0));
+  plcSimulator.set(PlcSimulator::IOType::Input, 1, true);
+  plcSimulator.execute<4>(program);
+  BOOST_CHECK(!plcSimulator.get(PlcSimulator::IOType::Output, 0));
+
+  // the truth table evaluates the fused operations as well
+  plc::TruthTable truthTable({ { Instruction::ReadInput, 0 }, { Instruction::ReadInput, 1 }, { Instruction::OperationOrNot, 0 },
+    { Instruction::OperationDup, 0 }, { Instruction::OperationAnd, 0 } });
+  truthTable.enumerate([](uint64_t, uint64_t result, unsigned)
+  {
+    BOOST_CHECK_EQUAL(result & 0xf, 0xbu);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_Fused)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3; outputs: q0=0, q1=1, q2=2; flags: f=0;"
+    "f = a & !b | c & !d; q0 = f & !c; q1 = !f | a & !(b | d); q2 = q2;", plcAst);
+
+  std::vector<plc::Operation> instructions;
+  plc::PlcOptimizer optimizer(plcAst, { plc::CompileOption::FusedOperations });
+  optimizer.compile(instructions);
+
+  BOOST_CHECK_GT(optimizer.statistics().peepholeRewrites, 0u);
+  BOOST_CHECK_GT(optimizer.statistics().bytesSaved(), 0);
+  checkEquivalence(plcAst, instructions, optimizer.statistics());
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_FusedStackDepth)
+{
+  using plc::Instruction;
+
+  // the Dup before WriteF leaves f on the stack for the equation of o
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3; outputs: o=0; flags: f=0;"
+    "f = a & b; o = (f & c) | (d & a);", plcAst);
+
+  std::vector<plc::Operation> instructions;
+  plc::PlcOptimizer optimizer(plcAst, { plc::CompileOption::FusedOperations });
+  optimizer.compile(instructions);
+
+  BOOST_REQUIRE(std::find_if(instructions.begin(), instructions.end(),
+    [](const plc::Operation& operation) { return operation.instruction == Instruction::OperationDup; }) != instructions.end());
+
+  PlcSimulator plcSimulator(4, 1, 1, 0);
+  unsigned maxStackDepth = plcSimulator.load(instructions).maxStackDepth();
+  BOOST_CHECK_EQUAL(maxStackDepth, 3u);
+
+  const plc::CompileStatistics& statistics = optimizer.statistics();
+  BOOST_CHECK_EQUAL(statistics.maxStackDepth, maxStackDepth);
+  BOOST_REQUIRE_EQUAL(statistics.stackDepths.size(), 2u);
+  BOOST_CHECK_EQUAL(statistics.stackDepths[0].second, 2u);
+  BOOST_CHECK_EQUAL(statistics.stackDepths[1].second, 3u);
+
+  std::vector<uint8_t> avrplc;
+  plc::translateAvr(instructions, avrplc);
+  BOOST_CHECK_EQUAL(AvrEmulator(avrplc, maxStackDepth).worstCase().maxStackDepth, statistics.maxStackDepth);
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_ConstantFolding)
+{
+  // variant without the heater: f is always false, q1 always true, q2 reduces to b
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, heater=2, manual=3; outputs: q0=0, q1=1, q2=2, q3=3; flags: f=0;"
+    "constants: heater=0, manual=1;"
+    "f = heater & a; q0 = a & !b | f; q1 = manual | a; q2 = !f & b & q1; q3 = !q1 | heater;", plcAst);
+
+  BOOST_CHECK_EQUAL(plcAst.constants().size(), 2u);
+  BOOST_CHECK_THROW(plcAst.setConstant("q0", true), PlcAstException);
+
+  std::vector<plc::Operation> instructions;
+  plc::PlcOptimizer optimizer(plcAst, { plc::CompileOption::ConstantFolding });
+  optimizer.compile(instructions);
+
+  const plc::CompileStatistics& statistics = optimizer.statistics();
+  BOOST_CHECK_EQUAL(statistics.foldedEquations, 5u);
+  BOOST_CHECK_EQUAL(statistics.constantEquations, 3u);
+  BOOST_CHECK_GT(statistics.bytesSaved(), 0);
+  for (const plc::Operation& operation : instructions)
+  {
+    BOOST_CHECK(operation.instruction != plc::Instruction::ReadInput || operation.argument < 2);
+    BOOST_CHECK(operation.instruction != plc::Instruction::WriteFlag);
+  }
+
+  checkEquivalence(plcAst, instructions, statistics);
+
+  plcAst.removeConstant("manual");
+  optimizer.compile(instructions);
+  BOOST_CHECK_EQUAL(optimizer.statistics().constantEquations, 1u);
+  checkEquivalence(plcAst, instructions, optimizer.statistics());
+}
+
+BOOST_AUTO_TEST_CASE(PlcOptimizer_RemapFlags)
+{
+  // f0 is only written, f1 read once, the flags above 30 are read 3 times each
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2; outputs: q0=0, q1=1, q2=2; flags: f0=0, f1=1, f40=40, f50=50, f300=300;"
+    "f0 = a; f1 = b; f40 = a & b; f50 = b | c; f300 = !c & f1;"
+    "q0 = f40 & f50 | f300; q1 = f40 | f50 & !f300; q2 = f40 & !f50 & f300;", plcAst);
+
+  // flag 300 needs version 2, which has to be requested
+  std::vector<plc::Operation> instructions;
+  plc::PlcOptimizer plain(plcAst, { plc::CompileOption::RemapFlags });
+  BOOST_CHECK_THROW(plain.compile(instructions), PlcException);
+
+  plc::PlcOptimizer optimizer(plcAst, { plc::CompileOption::RemapFlags }, avrplc::VERSION_2);
+  optimizer.compile(instructions);
+
+  const plc::CompileStatistics& statistics = optimizer.statistics();
+  BOOST_REQUIRE_EQUAL(statistics.flagMapping.size(), 301u);
+  BOOST_CHECK_EQUAL(statistics.flagMapping[40], 0u);
+  BOOST_CHECK_EQUAL(statistics.flagMapping[50], 1u);
+  BOOST_CHECK_EQUAL(statistics.flagMapping[300], 2u);
+  BOOST_CHECK_EQUAL(statistics.flagMapping[1], 3u);
+  BOOST_CHECK_EQUAL(statistics.flagMapping[0], 4u);
+  BOOST_CHECK_EQUAL(statistics.flagMapping[2], ~0u);
+
+  // 3 reads and 1 write of f40 and f50 save 1 byte each, the ones of f300 3 bytes each
+  BOOST_CHECK_EQUAL(statistics.remapSaved, 20u);
+  BOOST_CHECK_EQUAL(statistics.bytesSaved(), 20);
+
+  checkEquivalence(plcAst, instructions, statistics);
+}
+
+#endif // PARSER_TESTS
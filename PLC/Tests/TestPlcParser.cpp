@@ -1,7 +1,10 @@
 #ifdef PARSER_TESTS
 
+#include <thread>
+
 #include <boost/test/unit_test.hpp>
 #include "../PlcParser.h"
+#include "../include/plc.h"
 
 class PlcParserMock : public PlcParser<2, 3>
 {
@@ -19,7 +22,7 @@ public:
     return toOperator(parserResult);
   }
 
-  void parseExpressionMock(std::unique_ptr<plc::Expression>& expression)
+  void parseExpressionMock(plc::Expression*& expression)
   {
     parseExpression(expression);
   }
@@ -85,6 +88,121 @@ BOOST_AUTO_TEST_CASE(PlcParser_Term)
   BOOST_CHECK_THROW(plcParser.parseTermMock(term), ParserException);
 }
 
+BOOST_AUTO_TEST_CASE(PlcAst_VariableIds)
+{
+  PlcAst plcAst;
+  plcParse(
+    "inputs: a = 0, b = 1;\n"
+    "flags: f;\n"
+    "outputs: q = 0;\n"
+    "f = a & b;\n"
+    "q = f | a;\n", plcAst);
+
+  BOOST_CHECK_EQUAL(plcAst.variableCount(), 4u);
+  unsigned id = 0;
+  for (const char *name : { "a", "b", "f", "q" })
+  {
+    BOOST_CHECK_EQUAL(plcAst.id(name), id);
+    BOOST_CHECK_EQUAL(plcAst.variable(id).name(), name);
+    BOOST_CHECK_EQUAL(&plcAst.getVariable(name), &plcAst.variable(id));
+    id++;
+  }
+
+  const plc::Term& read = plcAst.getVariable("q").expression()->terms()[0];
+  BOOST_CHECK_EQUAL(read.variable()->id(), plcAst.id("f"));
+
+  std::vector<unsigned> uses(plcAst.variableUses());
+  BOOST_CHECK_EQUAL(uses[plcAst.id("a")], 2u);
+  BOOST_CHECK_EQUAL(uses[plcAst.id("f")], 2u);
+
+  BOOST_CHECK(!plcAst.variableExists("c"));
+  BOOST_CHECK_THROW(plcAst.id("c"), PlcAstException);
+  BOOST_CHECK_THROW(plcAst.addVariable(Variable("a", Variable::Type::Input, 2)), PlcAstException);
+
+  PlcAst other;
+  other.swap(plcAst);
+  BOOST_CHECK_EQUAL(plcAst.variableCount(), 0u);
+  BOOST_CHECK_EQUAL(other.getVariable("q").id(), 3u);
+
+  other.clear();
+  BOOST_CHECK(!other.variableExists("q"));
+}
+
+BOOST_AUTO_TEST_CASE(PlcAst_ExpressionArena)
+{
+  const char *source =
+    "inputs: a = 0, b = 1, c = 2;\n"
+    "outputs: q = 0, r = 1;\n"
+    "q = a & (b | c);\n"
+    "r = q | !(a & c) & b;\n";
+
+  PlcAst plcAst;
+  plcParse(source, plcAst);
+
+  size_t size = plcAst.arena().size();
+  BOOST_CHECK(size >= 4);
+  const plc::Expression& q = *plcAst.getVariable("q").expression();
+  BOOST_CHECK(q.inArena());
+  BOOST_CHECK(q.terms()[1].expression()->inArena());
+
+  // a copy is owned by its terms
+  plc::Expression copy(q);
+  BOOST_CHECK(!copy.inArena());
+  BOOST_CHECK(!copy.terms()[1].expression()->inArena());
+
+  plc::Expression resolved(plcAst.resolveDependencies("r"));
+  BOOST_CHECK(plcAst.arena().size() > size);
+
+  size_t capacity = plcAst.arena().capacity();
+  plcAst.clear();
+  BOOST_CHECK_EQUAL(plcAst.arena().size(), 0u);
+  BOOST_CHECK_EQUAL(plcAst.arena().capacity(), capacity);
+
+  plcParse(source, plcAst);
+  BOOST_CHECK_EQUAL(plcAst.arena().size(), size);
+  BOOST_CHECK_EQUAL(plcAst.arena().capacity(), capacity);
+}
+
+BOOST_AUTO_TEST_CASE(PlcAst_ExpressionIds)
+{
+  const char *source =
+    "inputs: a = 0, b = 1, c = 2;\n"
+    "outputs: q = 0;\n"
+    "flags: f = 0;\n"
+    "f = a | b & c;\n"
+    "q = f & !(a | c);\n";
+
+  // the ids of each PlcAst start at 1, no matter what was parsed before or at the same time
+  std::vector<PlcAst> plcAsts(4);
+  std::vector<std::thread> threads;
+  for (PlcAst& plcAst : plcAsts)
+    threads.emplace_back([&plcAst, source]() { plcParse(source, plcAst); });
+  for (std::thread& thread : threads)
+    thread.join();
+
+  unsigned lastId = plcAsts[0].arena().lastId();
+  BOOST_CHECK(lastId >= 2);
+  const plc::Expression& q = *plcAsts[0].getVariable("q").expression();
+  BOOST_CHECK(q.terms()[1].expression()->id() <= lastId);
+
+  for (const PlcAst& plcAst : plcAsts)
+  {
+    BOOST_CHECK_EQUAL(plcAst.arena().lastId(), lastId);
+    BOOST_CHECK_EQUAL(plcAst.getVariable("q").expression()->terms()[1].expression()->id(), q.terms()[1].expression()->id());
+  }
+
+  // an inserted expression gets the next id of its PlcAst
+  plc::Expression resolved(plcAsts[0].resolveDependencies("q"));
+  BOOST_CHECK(plcAsts[0].arena().lastId() > lastId);
+  BOOST_CHECK_EQUAL(plcAsts[1].arena().lastId(), lastId);
+
+  plcAsts[0].clear();
+  plcParse(source, plcAsts[0]);
+  BOOST_CHECK_EQUAL(plcAsts[0].arena().lastId(), lastId);
+
+  BOOST_CHECK(plc::Expression().id() == plc::Expression::NO_ID);
+}
+
 BOOST_AUTO_TEST_CASE(PlcParser_Vars)
 {
   std::istringstream in(": abc=0, xyz=1, min=2, no=3;");
@@ -123,6 +241,29 @@ BOOST_AUTO_TEST_CASE(PlcParser_Timer_Arg)
   BOOST_CHECK_EQUAL(plcAst.getVariable("no").time(), 30);
 }
 
+BOOST_AUTO_TEST_CASE(PlcParser_AutoIndex)
+{
+  // hot is read 3 times, warm twice, cold never, the declared fixed keeps index 0
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1; outputs: q0=0, q1=1; flags: cold, hot, fixed=0, warm; monoflops: m(4s), n(2s)=0;"
+    "cold = a; hot = a & b; warm = hot | b; q0 = hot & !warm | fixed; q1 = hot | warm & n; fixed = b; m = a; n = m;", plcAst);
+
+  BOOST_CHECK_EQUAL(plcAst.getVariable("fixed").index(), 0u);
+  BOOST_CHECK(!plcAst.getVariable("fixed").allocated());
+  BOOST_CHECK_EQUAL(plcAst.getVariable("hot").index(), 1u);
+  BOOST_CHECK(plcAst.getVariable("hot").allocated());
+  BOOST_CHECK_EQUAL(plcAst.getVariable("warm").index(), 2u);
+  BOOST_CHECK_EQUAL(plcAst.getVariable("cold").index(), 3u);
+  BOOST_CHECK_EQUAL(plcAst.maxVariableIndexOfType(Variable::Type::Flag), 3u);
+
+  BOOST_CHECK_EQUAL(plcAst.getVariable("m").index(), 1u);
+  BOOST_CHECK_EQUAL(plcAst.getVariable("m").time(), 2u);
+  BOOST_CHECK_EQUAL(plcAst.variableUses()[plcAst.id("hot")], 4u);
+
+  PlcAst noIndex;
+  BOOST_CHECK_THROW(plcParse("inputs: a;", noIndex), ParserException);
+}
+
 BOOST_AUTO_TEST_CASE(PlcParser_Expression_Precedence1)
 {
   std::istringstream in("a | b & c;");
@@ -135,7 +276,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Precedence1)
   plcAst.addVariable(Variable("b", Variable::Type::Input, 1));
   plcAst.addVariable(Variable("c", Variable::Type::Input, 2));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -171,7 +312,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Precedence2)
   plcAst.addVariable(Variable("b", Variable::Type::Input, 1));
   plcAst.addVariable(Variable("c", Variable::Type::Input, 2));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -208,7 +349,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Precedence3)
   plcAst.addVariable(Variable("b", Variable::Type::Input, 1));
   plcAst.addVariable(Variable("c", Variable::Type::Input, 2));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -244,7 +385,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Precedence4)
   plcAst.addVariable(Variable("b", Variable::Type::Input, 1));
   plcAst.addVariable(Variable("c", Variable::Type::Input, 2));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -281,7 +422,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Precedence5)
   plcAst.addVariable(Variable("c", Variable::Type::Input, 2));
   plcAst.addVariable(Variable("d", Variable::Type::Input, 3));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -320,7 +461,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Precedence6)
   plcAst.addVariable(Variable("c", Variable::Type::Input, 2));
   plcAst.addVariable(Variable("d", Variable::Type::Input, 3));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -362,7 +503,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Levels1)
 
   plcAst.addVariable(Variable("a", Variable::Type::Input, 0));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   plcParser.parseExpressionMock(expression);
   BOOST_CHECK(*expression);
@@ -381,7 +522,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Levels2)
   plcAst.addVariable(Variable("b", Variable::Type::Input, 1));
   plcAst.addVariable(Variable("c", Variable::Type::Input, 2));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -402,7 +543,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Levels3)
   plcAst.addVariable(Variable("b", Variable::Type::Input, 1));
   plcAst.addVariable(Variable("c", Variable::Type::Input, 2));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -424,7 +565,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Levels4)
   plcAst.addVariable(Variable("c", Variable::Type::Input, 2));
   plcAst.addVariable(Variable("d", Variable::Type::Input, 3));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -448,7 +589,7 @@ BOOST_AUTO_TEST_CASE(PlcParser_Expression_Levels5)
   plcAst.addVariable(Variable("e", Variable::Type::Input, 4));
   plcAst.addVariable(Variable("f", Variable::Type::Input, 5));
 
-  std::unique_ptr<plc::Expression> expression(new plc::Expression());
+  plc::Expression *expression = plcAst.arena().create();
 
   BOOST_CHECK(!*expression);
 
@@ -0,0 +1,97 @@
+#ifdef PARSER_TESTS
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcScanSimulator.h"
+
+namespace
+{
+  const char *MONOFLOP_PROGRAM = "inputs: t=0, s=1; outputs: q=0, r=1; monoflops: m(10s)=0; flags: f=0;"
+    "q = m; m = t; f = s & !m; r = f;";
+}
+
+BOOST_AUTO_TEST_CASE(PlcScanSimulator_Monoflop)
+{
+  PlcAst plcAst;
+  plcParse(MONOFLOP_PROGRAM, plcAst);
+
+  PlcScanSimulator scanSimulator(plcAst);
+  const PlcSimulator& simulator = scanSimulator.simulator();
+  BOOST_CHECK(scanSimulator.stable());
+  BOOST_CHECK(!simulator.get(PlcSimulator::IOType::Output, 0));
+
+  std::vector<plc::InputEvent> events{ { 0, 0, true }, { 1000, 0, false } };
+  scanSimulator.replay(events);
+  BOOST_CHECK(simulator.get(PlcSimulator::IOType::Output, 0));
+
+  // 10s are 5 ticks, the first tick is at 2000 ms
+  scanSimulator.advance(8000);
+  BOOST_CHECK_EQUAL(scanSimulator.now(), 9000u);
+  BOOST_CHECK(simulator.get(PlcSimulator::IOType::Output, 0));
+
+  scanSimulator.advance(1000);
+  BOOST_CHECK(!simulator.get(PlcSimulator::IOType::Output, 0));
+}
+
+BOOST_AUTO_TEST_CASE(PlcScanSimulator_Retrigger)
+{
+  PlcAst plcAst;
+  plcParse(MONOFLOP_PROGRAM, plcAst);
+
+  PlcScanSimulator scanSimulator(plcAst);
+  const PlcSimulator& simulator = scanSimulator.simulator();
+
+  std::vector<plc::InputEvent> events{ { 0, 0, true }, { 0, 1, true }, { 3600000, 0, false } };
+
+  std::vector<uint64_t> changes;
+  bool r = false;
+  scanSimulator.replay(events, [&changes, &r](uint64_t ms, const PlcSimulator& simulator)
+  {
+    if (simulator.get(PlcSimulator::IOType::Output, 1) != r)
+    {
+      r = !r;
+      changes.emplace_back(ms);
+    }
+  });
+
+  BOOST_CHECK(simulator.get(PlcSimulator::IOType::Output, 0));
+  BOOST_CHECK(!simulator.get(PlcSimulator::IOType::Output, 1));
+
+  scanSimulator.advance(24 * 3600000ull, [&changes, &r](uint64_t ms, const PlcSimulator& simulator)
+  {
+    if (simulator.get(PlcSimulator::IOType::Output, 1) != r)
+    {
+      r = !r;
+      changes.emplace_back(ms);
+    }
+  });
+
+  BOOST_CHECK(!simulator.get(PlcSimulator::IOType::Output, 0));
+  BOOST_CHECK(simulator.get(PlcSimulator::IOType::Output, 1));
+  BOOST_REQUIRE_EQUAL(changes.size(), 1u);
+  BOOST_CHECK_EQUAL(changes[0], 3610000u);
+
+  // a day of simulated time takes a handful of scans
+  BOOST_CHECK_LT(scanSimulator.scans(), 20u);
+}
+
+BOOST_AUTO_TEST_CASE(PlcScanSimulator_Events)
+{
+  PlcAst plcAst;
+  plcParse(MONOFLOP_PROGRAM, plcAst);
+
+  std::istringstream in("# comment\n\n2000 s 1\n1000 t 1\n");
+  std::vector<plc::InputEvent> events(plc::readInputEvents(in, plcAst));
+  BOOST_REQUIRE_EQUAL(events.size(), 2u);
+  BOOST_CHECK_EQUAL(events[0].ms, 1000u);
+  BOOST_CHECK_EQUAL(events[0].input, 0u);
+  BOOST_CHECK(events[0].value);
+
+  std::istringstream notAnInput("1000 q 1\n");
+  BOOST_CHECK_THROW(plc::readInputEvents(notAnInput, plcAst), PlcException);
+
+  std::istringstream badValue("1000 t 2\n");
+  BOOST_CHECK_THROW(plc::readInputEvents(badValue, plcAst), PlcException);
+}
+
+#endif // PARSER_TESTS
@@ -0,0 +1,140 @@
+#ifdef PARSER_TESTS
+
+#include <boost/test/unit_test.hpp>
+#include "../include/PlcSimulator.h"
+
+namespace
+{
+  class CountingIO : public IO
+  {
+  public:
+
+    virtual operator bool() const override
+    {
+      reads++;
+      return IO::operator bool();
+    }
+
+    mutable unsigned reads = 0;
+  };
+}
+
+BOOST_AUTO_TEST_CASE(PlcSimulator_Packed)
+{
+  PlcSimulator plcSimulator(70, 2, 2, 1);
+
+  BOOST_CHECK_EQUAL(plcSimulator.size(PlcSimulator::IOType::Input), 70u);
+
+  plcSimulator.io(PlcSimulator::IOType::Input, 69) = true;
+  BOOST_CHECK(plcSimulator.get(PlcSimulator::IOType::Input, 69));
+  BOOST_CHECK(!plcSimulator.get(PlcSimulator::IOType::Input, 5));
+  BOOST_CHECK(!plcSimulator.get(PlcSimulator::IOType::Output, 0));
+
+  plcSimulator.set(PlcSimulator::IOType::Flag, 1, true);
+  BOOST_CHECK(plcSimulator.io(PlcSimulator::IOType::Flag, 1));
+
+  BOOST_CHECK_THROW(plcSimulator.io(PlcSimulator::IOType::Input, 70), PlcException);
+  BOOST_CHECK_THROW(plcSimulator.get(PlcSimulator::IOType::Monoflop, 1), PlcException);
+
+  plcSimulator.resetAll();
+  BOOST_CHECK(!plcSimulator.io(PlcSimulator::IOType::Input, 69));
+  BOOST_CHECK(!plcSimulator.get(PlcSimulator::IOType::Flag, 1));
+}
+
+BOOST_AUTO_TEST_CASE(PlcSimulator_Execute)
+{
+  // o0 = i0 & !i65
+  std::vector<plc::Operation> instructions{
+    { plc::Instruction::ReadInput, 0 },
+    { plc::Instruction::ReadInput, 65 },
+    { plc::Instruction::OperationNot, 0 },
+    { plc::Instruction::OperationAnd, 0 },
+    { plc::Instruction::WriteOuput, 0 },
+    { plc::Instruction::ReadOutput, 0 } };
+
+  PlcSimulator plcSimulator(66, 1, 0, 0);
+
+  BOOST_CHECK(!plcSimulator.execute<2>(instructions));
+
+  plcSimulator.set(PlcSimulator::IOType::Input, 0, true);
+  BOOST_CHECK(plcSimulator.execute<2>(instructions));
+  BOOST_CHECK(plcSimulator.get(PlcSimulator::IOType::Output, 0));
+
+  plcSimulator.set(PlcSimulator::IOType::Input, 65, true);
+  BOOST_CHECK(!plcSimulator.execute<2>(instructions));
+  BOOST_CHECK(!plcSimulator.get(PlcSimulator::IOType::Output, 0));
+
+  std::vector<plc::Operation> outOfBounds{ { plc::Instruction::ReadInput, 66 } };
+  BOOST_CHECK_THROW(plcSimulator.execute<2>(outOfBounds), PlcException);
+}
+
+BOOST_AUTO_TEST_CASE(PlcSimulator_Overlay)
+{
+  std::vector<plc::Operation> instructions{
+    { plc::Instruction::ReadInput, 0 },
+    { plc::Instruction::ReadInput, 1 },
+    { plc::Instruction::OperationOr, 0 } };
+
+  PlcSimulator plcSimulator(2, 0, 0, 0);
+
+  CountingIO *countingIO = new CountingIO();
+  plcSimulator.setIO(PlcSimulator::IOType::Input, 1, std::unique_ptr<IO>(countingIO));
+
+  BOOST_CHECK(!plcSimulator.execute<2>(instructions));
+  BOOST_CHECK_EQUAL(countingIO->reads, 1u);
+
+  plcSimulator.io(PlcSimulator::IOType::Input, 1) = true;
+  BOOST_CHECK(plcSimulator.execute<2>(instructions));
+  BOOST_CHECK_EQUAL(countingIO->reads, 2u);
+
+  // the packed bit is untouched by the overlay
+  plcSimulator.setIO(PlcSimulator::IOType::Input, 1, std::unique_ptr<IO>());
+  BOOST_CHECK(!plcSimulator.execute<2>(instructions));
+}
+
+BOOST_AUTO_TEST_CASE(PlcSimulator_Load)
+{
+  PlcSimulator plcSimulator(3, 1, 1, 0);
+
+  // f0 = i0 | i1 & i2; o0 = f0
+  std::vector<plc::Operation> instructions{
+    { plc::Instruction::ReadInput, 0 },
+    { plc::Instruction::ReadInput, 1 },
+    { plc::Instruction::ReadInput, 2 },
+    { plc::Instruction::OperationAnd, 0 },
+    { plc::Instruction::OperationOr, 0 },
+    { plc::Instruction::WriteFlag, 0 },
+    { plc::Instruction::ReadFlag, 0 },
+    { plc::Instruction::WriteOuput, 0 } };
+
+  PlcProgram program(plcSimulator.load(instructions));
+  BOOST_CHECK_EQUAL(program.maxStackDepth(), 3u);
+  BOOST_CHECK(!program.hasResult());
+  BOOST_CHECK_EQUAL(program.steps().size(), instructions.size());
+
+  BOOST_CHECK_THROW(plcSimulator.execute<2>(program), PlcException);
+
+  plcSimulator.set(PlcSimulator::IOType::Input, 1, true);
+  plcSimulator.set(PlcSimulator::IOType::Input, 2, true);
+  BOOST_CHECK(!plcSimulator.execute<3>(program));
+  BOOST_CHECK(plcSimulator.get(PlcSimulator::IOType::Flag, 0));
+  BOOST_CHECK(plcSimulator.get(PlcSimulator::IOType::Output, 0));
+
+  plcSimulator.set(PlcSimulator::IOType::Input, 2, false);
+  plcSimulator.execute<3>(program);
+  BOOST_CHECK(!plcSimulator.get(PlcSimulator::IOType::Output, 0));
+
+  std::vector<plc::Operation> underflow{ { plc::Instruction::OperationNot, 0 } };
+  BOOST_CHECK_THROW(plcSimulator.load(underflow), PlcException);
+
+  std::vector<plc::Operation> leftOver{ { plc::Instruction::ReadInput, 0 }, { plc::Instruction::ReadInput, 1 } };
+  BOOST_CHECK_THROW(plcSimulator.load(leftOver), PlcException);
+
+  std::vector<plc::Operation> outOfBounds{ { plc::Instruction::ReadMonoflop, 0 } };
+  BOOST_CHECK_THROW(plcSimulator.load(outOfBounds), PlcException);
+
+  PlcSimulator other(4, 1, 1, 0);
+  BOOST_CHECK_THROW(other.execute<3>(program), PlcException);
+}
+
+#endif // PARSER_TESTS
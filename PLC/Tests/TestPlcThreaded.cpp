@@ -0,0 +1,75 @@
+#ifdef PARSER_TESTS
+
+#include <random>
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcOptimizer.h"
+#include "../include/PlcScanSimulator.h"
+#include "../include/PlcThreaded.h"
+
+BOOST_AUTO_TEST_CASE(PlcThreaded_Equivalence)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3, e=4, g=70;"
+    "outputs: o0=0, o1=1, o2=2, o3=65; flags: f0=0, f1=1, latch=2; monoflops: m(4s)=0, n=1;"
+    "f0 = a & b; f1 = f0 | c & !g; o0 = f1 & !d; o1 = !f0 & e | !(a | c);"
+    "latch = e | latch & !g; o2 = latch; m = d; n = a & !latch; o3 = m | n & b;", plcAst);
+
+  for (bool fused : { false, true })
+  {
+    std::vector<plc::Operation> instructions;
+    plc::PlcOptimizer optimizer(plcAst, fused ? std::vector<plc::CompileOption>{ plc::CompileOption::FusedOperations } : std::vector<plc::CompileOption>());
+    optimizer.compile(instructions);
+
+    PlcSimulator interpreted(plc::createSimulator(plcAst));
+    PlcSimulator threaded(plc::createSimulator(plcAst));
+    PlcProgram program(interpreted.load(instructions));
+    PlcThreadedProgram threadedProgram(threaded.load(instructions));
+
+    std::mt19937 random(5);
+    for (unsigned scan = 0; scan < 2000; scan++)
+    {
+      unsigned input = random() % 6;
+      input = input == 5 ? 70 : input;
+      bool value = (random() & 1) != 0;
+      interpreted.set(PlcSimulator::IOType::Input, input, value);
+      threaded.set(PlcSimulator::IOType::Input, input, value);
+
+      interpreted.clearTriggered();
+      threaded.clearTriggered();
+      interpreted.execute<16>(program);
+      threaded.execute<16>(threadedProgram);
+      BOOST_REQUIRE(interpreted.image() == threaded.image());
+      BOOST_REQUIRE_EQUAL(interpreted.nextExpiry(), threaded.nextExpiry());
+
+      unsigned ticks = random() % 3;
+      BOOST_REQUIRE_EQUAL(interpreted.tick(ticks), threaded.tick(ticks));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PlcThreaded_Result)
+{
+  using plc::Instruction;
+
+  PlcSimulator plcSimulator(2, 0, 0, 0);
+  PlcThreadedProgram threadedProgram(plcSimulator.load({ { Instruction::ReadInput, 0 }, { Instruction::OperationDup, 0 },
+    { Instruction::ReadInput, 1 }, { Instruction::OperationOrNot, 0 }, { Instruction::OperationAnd, 0 } }));
+
+  // a & (a | !b)
+  plcSimulator.set(PlcSimulator::IOType::Input, 0, true);
+  BOOST_CHECK(plcSimulator.execute<3>(threadedProgram));
+  plcSimulator.set(PlcSimulator::IOType::Input, 1, true);
+  BOOST_CHECK(plcSimulator.execute<3>(threadedProgram));
+  plcSimulator.set(PlcSimulator::IOType::Input, 0, false);
+  BOOST_CHECK(!plcSimulator.execute<3>(threadedProgram));
+
+  BOOST_CHECK_THROW(plcSimulator.execute<2>(threadedProgram), PlcException);
+
+  std::vector<plc::Operation> deep(65, plc::Operation{ Instruction::ReadInput, 0 });
+  deep.insert(deep.end(), 64, plc::Operation{ Instruction::OperationAnd, 0 });
+  BOOST_CHECK_THROW(PlcThreadedProgram(plcSimulator.load(deep)), PlcException);
+}
+
+#endif // PARSER_TESTS
@@ -0,0 +1,77 @@
+#ifdef PARSER_TESTS
+
+#include <boost/test/unit_test.hpp>
+#include "../include/plc.h"
+#include "../include/PlcCompiler.h"
+#include "../include/PlcTruthTable.h"
+
+namespace
+{
+  std::vector<plc::Operation> compileExpression(const PlcAst& plcAst, const std::string& name)
+  {
+    std::vector<plc::Operation> instructions;
+    plc::compile(plcAst, *plcAst.getVariable(name).expression(), [&instructions](plc::Instruction instruction, unsigned argument)
+    {
+      instructions.emplace_back(plc::Operation{ instruction, argument });
+    });
+
+    return instructions;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PlcTruthTable_Small)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1; outputs: q=0; q = !(a | b);", plcAst);
+
+  plc::TruthTable truthTable(compileExpression(plcAst, "q"));
+  BOOST_CHECK_EQUAL(truthTable.variables().size(), 2u);
+  BOOST_CHECK_EQUAL(truthTable.rows(), 4u);
+
+  unsigned calls = 0;
+  truthTable.enumerate([&calls](uint64_t firstRow, uint64_t result, unsigned lanes)
+  {
+    calls++;
+    BOOST_CHECK_EQUAL(firstRow, 0u);
+    BOOST_CHECK_EQUAL(lanes, 4u);
+    BOOST_CHECK_EQUAL(result & 0xf, 0x1u);
+  });
+  BOOST_CHECK_EQUAL(calls, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(PlcTruthTable_Simulator)
+{
+  PlcAst plcAst;
+  plcParse("inputs: a=0, b=1, c=2, d=3, e=4, f=5, g=6, h=7; outputs: q=0;"
+    "q = a & !b | (c | !d) & e & !(f & g) | h & a;", plcAst);
+
+  std::vector<plc::Operation> instructions(compileExpression(plcAst, "q"));
+  plc::TruthTable truthTable(instructions);
+  BOOST_CHECK_EQUAL(truthTable.variables().size(), 8u);
+
+  PlcSimulator plcSimulator(8, 1, 0, 0);
+  PlcProgram program(plcSimulator.load(instructions));
+
+  truthTable.enumerate([&](uint64_t firstRow, uint64_t result, unsigned lanes)
+  {
+    for (unsigned lane = 0; lane < lanes; lane++)
+    {
+      uint64_t row = firstRow + lane;
+      for (unsigned i = 0; i < truthTable.variables().size(); i++)
+        plcSimulator.set(PlcSimulator::IOType::Input, truthTable.variables()[i].argument, (row >> i) & 1);
+
+      BOOST_CHECK_EQUAL(plcSimulator.execute<4>(program), ((result >> lane) & 1) != 0);
+    }
+  });
+}
+
+BOOST_AUTO_TEST_CASE(PlcTruthTable_Invalid)
+{
+  std::vector<plc::Operation> write{ { plc::Instruction::ReadInput, 0 }, { plc::Instruction::WriteOuput, 0 } };
+  BOOST_CHECK_THROW(plc::TruthTable truthTable(write), PlcException);
+
+  std::vector<plc::Operation> leftOver{ { plc::Instruction::ReadInput, 0 }, { plc::Instruction::ReadInput, 1 } };
+  BOOST_CHECK_THROW(plc::TruthTable truthTable(leftOver), PlcException);
+}
+
+#endif // PARSER_TESTS
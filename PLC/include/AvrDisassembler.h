@@ -0,0 +1,214 @@
+#ifndef _INCLUDE_AVR_DISASSEMBLER_H_
+#define _INCLUDE_AVR_DISASSEMBLER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <ostream>
+
+#include "PlcCompiler.h"
+
+namespace plc
+{
+  inline const char *mnemonic(Instruction instruction)
+  {
+    switch (instruction)
+    {
+    case Instruction::ReadInput:        return "Read Input";
+    case Instruction::ReadOutput:       return "Read Output";
+    case Instruction::ReadFlag:         return "Read Flag";
+    case Instruction::ReadMonoflop:     return "Read Monoflop";
+    case Instruction::WriteOuput:       return "Write Output";
+    case Instruction::WriteFlag:        return "Write Flag";
+    case Instruction::WriteMonoflop:    return "Write Monoflop";
+    case Instruction::OperationAnd:     return "And";
+    case Instruction::OperationOr:      return "Or";
+    case Instruction::OperationNot:     return "Not";
+    case Instruction::OperationAndNot:  return "And Not";
+    case Instruction::OperationOrNot:   return "Or Not";
+    case Instruction::OperationDup:     return "Dup";
+    default:
+      throw PlcException("undefined Instruction: %d", int(instruction));
+    }
+  }
+
+  /// <summary>
+  /// The names of the variables read or written by instructions. Flags allocated by the
+  /// PlcOptimizer have no name, they are called flag 61.
+  /// </summary>
+  class VariableNames
+  {
+  public:
+
+    VariableNames()
+    {
+    }
+
+    VariableNames(const PlcAst& plcAst)
+    {
+      for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
+        names_[std::make_pair(readInstruction(it->second.type()), it->second.index())] = it->first;
+    }
+
+    /// <summary>
+    /// The name of the variable of a read or write, empty for an operation
+    /// </summary>
+    std::string operator()(const Operation& operation) const
+    {
+      Instruction read;
+      switch (operation.instruction)
+      {
+      case Instruction::ReadInput:
+      case Instruction::ReadOutput:
+      case Instruction::ReadFlag:
+      case Instruction::ReadMonoflop:
+        read = operation.instruction;
+        break;
+      case Instruction::WriteOuput:
+        read = Instruction::ReadOutput;
+        break;
+      case Instruction::WriteFlag:
+        read = Instruction::ReadFlag;
+        break;
+      case Instruction::WriteMonoflop:
+        read = Instruction::ReadMonoflop;
+        break;
+      default:
+        return std::string();
+      }
+
+      auto found = names_.find(std::make_pair(read, operation.argument));
+      if (found != names_.end())
+        return found->second;
+
+      static const char *types[] = { "input ", "output ", "flag ", "monoflop " };
+      return types[unsigned(read) - unsigned(Instruction::ReadInput)] + std::to_string(operation.argument);
+    }
+
+  private:
+
+    std::map<std::pair<Instruction, unsigned>, std::string> names_;
+  };
+
+  /// <summary>
+  /// Code size of one equation of AVR byte code, an equation ends with its write
+  /// </summary>
+  struct EquationSize
+  {
+    Operation write;
+    unsigned address;
+    unsigned instructions;
+    unsigned bytes;
+  };
+
+  /// <summary>
+  /// The code size of each equation, instructions after the last write are not counted.
+  /// </summary>
+  inline std::vector<EquationSize> equationSizes(const std::vector<uint8_t>& avrplc)
+  {
+    std::vector<Operation> instructions;
+    std::vector<unsigned> addresses;
+    decodeAvr(avrplc, instructions, &addresses);
+    addresses.emplace_back(unsigned(avrplc.size()));
+
+    std::vector<EquationSize> result;
+    unsigned first = 0;
+    for (unsigned i = 0; i < instructions.size(); i++)
+      if (instructions[i].instruction == Instruction::WriteOuput || instructions[i].instruction == Instruction::WriteFlag
+        || instructions[i].instruction == Instruction::WriteMonoflop)
+      {
+        result.emplace_back(EquationSize{ instructions[i], addresses[first], i + 1 - first, addresses[i + 1] - addresses[first] });
+        first = i + 1;
+      }
+
+    return result;
+  }
+
+  /// <summary>
+  /// Prints the address, the bytes and the mnemonic of each instruction, followed by the
+  /// variable name for reads and writes. An empty line separates the equations.
+  /// </summary>
+  inline void disassembleAvr(const std::vector<uint8_t>& avrplc, const VariableNames& names, std::ostream& out)
+  {
+    std::vector<Operation> instructions;
+    std::vector<unsigned> addresses;
+    decodeAvr(avrplc, instructions, &addresses);
+    addresses.emplace_back(unsigned(avrplc.size()));
+
+    std::ios::fmtflags flags(out.flags());
+    out << std::hex << std::uppercase << std::setfill('0');
+    for (unsigned i = 0; i < instructions.size(); i++)
+    {
+      out << std::setw(4) << addresses[i] << "  ";
+      for (unsigned address = addresses[i]; address < addresses[i] + 2; address++)
+        if (address < addresses[i + 1])
+          out << std::setw(2) << unsigned(avrplc[address]) << ' ';
+        else
+          out << "   ";
+
+      std::string name(names(instructions[i]));
+      out << ' ' << mnemonic(instructions[i].instruction);
+      if (!name.empty())
+        out << ' ' << name;
+      out << '\n';
+
+      if (instructions[i].instruction == Instruction::WriteOuput || instructions[i].instruction == Instruction::WriteFlag
+        || instructions[i].instruction == Instruction::WriteMonoflop)
+        out << '\n';
+    }
+    out.flags(flags);
+  }
+
+  /// <summary>
+  /// An equation with different code sizes in two images, a size of 0 if it is missing in one of them
+  /// </summary>
+  struct SizeDifference
+  {
+    std::string name;
+    unsigned bytesBefore;
+    unsigned bytesAfter;
+  };
+
+  /// <summary>
+  /// Compares the code size of the equations of two images by the name of the written variable.
+  /// A variable written more than once, like a flag reused by the PlcOptimizer, is compared by occurrence.
+  /// </summary>
+  inline std::vector<SizeDifference> compareSizes(const std::vector<EquationSize>& before, const std::vector<EquationSize>& after, const VariableNames& names)
+  {
+    std::vector<std::string> order;
+    std::map<std::string, std::pair<unsigned, unsigned>> sizes;
+    auto collect = [&](const std::vector<EquationSize>& equations, bool isAfter)
+    {
+      std::map<std::string, unsigned> occurrences;
+      for (const EquationSize& equation : equations)
+      {
+        std::string name(names(equation.write));
+        unsigned occurrence = occurrences[name]++;
+        if (occurrence)
+          name += '#' + std::to_string(occurrence + 1);
+
+        auto inserted = sizes.emplace(name, std::make_pair(0u, 0u));
+        if (inserted.second)
+          order.emplace_back(name);
+
+        (isAfter ? inserted.first->second.second : inserted.first->second.first) = equation.bytes;
+      }
+    };
+
+    collect(before, false);
+    collect(after, true);
+
+    std::vector<SizeDifference> result;
+    for (const std::string& name : order)
+    {
+      const std::pair<unsigned, unsigned>& size = sizes[name];
+      if (size.first != size.second)
+        result.emplace_back(SizeDifference{ name, size.first, size.second });
+    }
+
+    return result;
+  }
+}
+
+#endif // !_INCLUDE_AVR_DISASSEMBLER_H_
@@ -0,0 +1,372 @@
+#ifndef _INCLUDE_AVR_EMULATOR_H_
+#define _INCLUDE_AVR_EMULATOR_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "AvrPlc.h"
+#include "PlcSimulator.h"
+
+/// <summary>
+/// Cycle costs of the AVR runtime, an estimate for an interpreter loop reading the byte code
+/// with LPM from flash and keeping the bit stack in registers. Adjust them to the runtime
+/// actually flashed, the defaults are for an ATmega with the process image in SRAM.
+/// </summary>
+struct AvrCycleModel
+{
+  // loop setup and return of one scan
+  unsigned scan = 24;
+
+  // LPM of the instruction byte, splitting instruction and argument, dispatch by IJMP
+  unsigned fetch = 12;
+
+  // LPM of the second byte and the 16 bit add of an argument above 30
+  unsigned extended = 5;
+
+  // the compare with FF and LPM of the 2 more bytes of an argument above 285, on top of extended
+  unsigned wide = 7;
+
+  // byte address and bit mask of the argument, LD, shift into the stack
+  unsigned read = 14;
+
+  // byte address and bit mask, LD, set or clear the bit, ST
+  unsigned write = 16;
+
+  // loading the time and storing the 16 bit counter of a triggered monoflop
+  unsigned trigger = 10;
+
+  // Not, And, Or, And Not and Or Not on the register stack
+  unsigned operation = 4;
+
+  unsigned dup = 3;
+};
+
+/// <summary>
+/// The work of one scan, counted by AvrEmulator::scan()
+/// </summary>
+struct AvrScanStatistics
+{
+  unsigned instructions = 0;
+  unsigned bytes = 0;
+  unsigned reads = 0;
+  unsigned writes = 0;
+  unsigned operations = 0;
+
+  // instructions with the second argument byte, and those of them with 4 bytes
+  unsigned extended = 0;
+  unsigned wide = 0;
+
+  // triggered monoflops
+  unsigned triggers = 0;
+
+  unsigned maxStackDepth = 0;
+  uint64_t cycles = 0;
+
+  double microseconds(unsigned clockHz) const
+  {
+    return double(cycles) * 1e6 / clockHz;
+  }
+};
+
+/// <summary>
+/// Executes the byte code of plc::translateAvr() on the process image of a PlcSimulator,
+/// byte by byte like the AVR runtime, and counts the cycles of each scan with an AvrCycleModel.
+/// The byte code is validated once by the constructor, the indices against the PlcSimulator
+/// by every scan.
+/// </summary>
+class AvrEmulator
+{
+public:
+
+  // the bit stack is one word
+  static constexpr const unsigned MAX_STACK_DEPTH = 64;
+
+  AvrEmulator(const std::vector<uint8_t>& avrplc, unsigned stackSize = 16, const AvrCycleModel& model = AvrCycleModel())
+    : avrplc_(avrplc), stackSize_(stackSize), model_(model)
+  {
+    if (stackSize_ > MAX_STACK_DEPTH)
+      throw PlcException("stack size %d, the bit stack has: %d", stackSize_, MAX_STACK_DEPTH);
+
+    unsigned depth = 0;
+    for (size_t pc = 0; pc < avrplc_.size();)
+    {
+      size_t start = pc;
+      uint8_t instruction;
+      unsigned argument;
+      decode(pc, instruction, argument);
+
+      unsigned pops = stackPops(instruction, argument);
+      if (depth < pops)
+        throw PlcException("stack underflow at byte %d", unsigned(start));
+
+      depth += stackPushes(instruction, argument) - pops;
+      if (depth > stackSize_)
+        throw PlcException("program needs a stack size of %d at byte %d, available: %d", depth, unsigned(start), stackSize_);
+    }
+
+    if (depth > 1)
+      throw PlcException("%d values left on the stack", depth);
+  }
+
+  /// <summary>
+  /// Executes one scan, returns the value left on the stack by a program without a write.
+  /// </summary>
+  bool scan(PlcSimulator& simulator)
+  {
+    statistics_ = AvrScanStatistics();
+    statistics_.bytes = unsigned(avrplc_.size());
+    statistics_.cycles = model_.scan;
+
+    uint64_t stack = 0;
+    unsigned depth = 0;
+    for (size_t pc = 0; pc < avrplc_.size();)
+    {
+      uint8_t instruction;
+      unsigned argument;
+      extension(statistics_, decode(pc, instruction, argument));
+
+      statistics_.instructions++;
+      statistics_.cycles += model_.fetch;
+
+      switch (instruction)
+      {
+      case avrplc::READ_INPUT:
+        push(stack, depth, simulator.get(PlcSimulator::IOType::Input, argument));
+        break;
+      case avrplc::READ_OUTPUT:
+        push(stack, depth, simulator.get(PlcSimulator::IOType::Output, argument));
+        break;
+      case avrplc::READ_FLAG:
+        push(stack, depth, simulator.get(PlcSimulator::IOType::Flag, argument));
+        break;
+      case avrplc::READ_MONOFLOP:
+        push(stack, depth, simulator.get(PlcSimulator::IOType::Monoflop, argument));
+        break;
+      case avrplc::WRITE_OUTPUT:
+        simulator.set(PlcSimulator::IOType::Output, argument, pop(stack, depth));
+        break;
+      case avrplc::WRITE_FLAG:
+        simulator.set(PlcSimulator::IOType::Flag, argument, pop(stack, depth));
+        break;
+      case avrplc::WRITE_MONOFLOP:
+        if (pop(stack, depth))
+        {
+          statistics_.triggers++;
+          statistics_.cycles += model_.trigger;
+          simulator.trigger(argument, true);
+        }
+        else
+          simulator.trigger(argument, false);
+        break;
+      default:
+        operation(stack, depth, argument);
+        break;
+      }
+    }
+
+    return depth == 1 && (stack & 1) != 0;
+  }
+
+  /// <summary>
+  /// The statistics of the last scan
+  /// </summary>
+  const AvrScanStatistics& statistics() const
+  {
+    return statistics_;
+  }
+
+  /// <summary>
+  /// The statistics of a scan, which triggers every monoflop, without executing it
+  /// </summary>
+  AvrScanStatistics worstCase() const
+  {
+    AvrScanStatistics statistics;
+    statistics.bytes = unsigned(avrplc_.size());
+    statistics.cycles = model_.scan;
+
+    unsigned depth = 0;
+    for (size_t pc = 0; pc < avrplc_.size();)
+    {
+      uint8_t instruction;
+      unsigned argument;
+      extension(statistics, decode(pc, instruction, argument));
+
+      statistics.instructions++;
+      statistics.cycles += model_.fetch + cost(instruction, argument);
+      count(statistics, instruction);
+      if (instruction == avrplc::WRITE_MONOFLOP)
+      {
+        statistics.triggers++;
+        statistics.cycles += model_.trigger;
+      }
+
+      depth += stackPushes(instruction, argument) - stackPops(instruction, argument);
+      if (depth > statistics.maxStackDepth)
+        statistics.maxStackDepth = depth;
+    }
+
+    return statistics;
+  }
+
+  const AvrCycleModel& model() const
+  {
+    return model_;
+  }
+
+private:
+
+  /// <summary>
+  /// Decodes the instruction at pc and advances it, returns the number of argument bytes.
+  /// </summary>
+  unsigned decode(size_t& pc, uint8_t& instruction, unsigned& argument) const
+  {
+    uint8_t code = avrplc_[pc++];
+    instruction = code & avrplc::INSTRUCTION_MASK;
+    argument = code & avrplc::ARGUMENT_MASK;
+
+    if (instruction == avrplc::OPERATION)
+    {
+      if (argument > avrplc::DUP)
+        throw PlcException("reserved operation %d at byte %d", argument, unsigned(pc - 1));
+
+      return 0;
+    }
+
+    if (argument != avrplc::ARGUMENT_EXTENDED)
+      return 0;
+
+    if (pc == avrplc_.size())
+      throw PlcException("extended argument missing at byte %d", unsigned(pc - 1));
+
+    if (avrplc_[pc] != avrplc::ARGUMENT_WIDE)
+    {
+      argument += avrplc_[pc++];
+      return 1;
+    }
+
+    if (avrplc_.size() - pc < 3)
+      throw PlcException("wide argument missing at byte %d", unsigned(pc - 1));
+
+    argument = avrplc_[pc + 1] | (unsigned(avrplc_[pc + 2]) << 8);
+    pc += 3;
+    return 3;
+  }
+
+  void extension(AvrScanStatistics& statistics, unsigned bytes) const
+  {
+    if (!bytes)
+      return;
+
+    statistics.extended++;
+    statistics.cycles += model_.extended;
+    if (bytes > 1)
+    {
+      statistics.wide++;
+      statistics.cycles += model_.wide;
+    }
+  }
+
+  static unsigned stackPops(uint8_t instruction, unsigned argument)
+  {
+    if (instruction < avrplc::OPERATION)
+      return 0;
+    if (instruction > avrplc::OPERATION || argument == avrplc::NOT || argument == avrplc::DUP)
+      return 1;
+
+    return 2;
+  }
+
+  static unsigned stackPushes(uint8_t instruction, unsigned argument)
+  {
+    if (instruction > avrplc::OPERATION)
+      return 0;
+
+    return (instruction == avrplc::OPERATION && argument == avrplc::DUP) ? 2 : 1;
+  }
+
+  unsigned cost(uint8_t instruction, unsigned argument) const
+  {
+    if (instruction < avrplc::OPERATION)
+      return model_.read;
+    if (instruction > avrplc::OPERATION)
+      return model_.write;
+
+    return argument == avrplc::DUP ? model_.dup : model_.operation;
+  }
+
+  static void count(AvrScanStatistics& statistics, uint8_t instruction)
+  {
+    if (instruction < avrplc::OPERATION)
+      statistics.reads++;
+    else if (instruction > avrplc::OPERATION)
+      statistics.writes++;
+    else
+      statistics.operations++;
+  }
+
+  void push(uint64_t& stack, unsigned& depth, bool value)
+  {
+    stack = (stack << 1) | (value ? 1 : 0);
+    depth++;
+    if (depth > statistics_.maxStackDepth)
+      statistics_.maxStackDepth = depth;
+
+    statistics_.reads++;
+    statistics_.cycles += model_.read;
+  }
+
+  bool pop(uint64_t& stack, unsigned& depth)
+  {
+    bool value = (stack & 1) != 0;
+    stack >>= 1;
+    depth--;
+
+    statistics_.writes++;
+    statistics_.cycles += model_.write;
+
+    return value;
+  }
+
+  void operation(uint64_t& stack, unsigned& depth, unsigned argument)
+  {
+    uint64_t top = stack & 1;
+    switch (argument)
+    {
+    case avrplc::NOT:
+      stack ^= 1;
+      break;
+    case avrplc::AND:
+      stack = (stack >> 1) & (top | ~uint64_t(1));
+      depth--;
+      break;
+    case avrplc::OR:
+      stack = (stack >> 1) | top;
+      depth--;
+      break;
+    case avrplc::AND_NOT:
+      stack = (stack >> 1) & ((top ^ 1) | ~uint64_t(1));
+      depth--;
+      break;
+    case avrplc::OR_NOT:
+      stack = (stack >> 1) | (top ^ 1);
+      depth--;
+      break;
+    case avrplc::DUP:
+      stack = (stack << 1) | top;
+      depth++;
+      if (depth > statistics_.maxStackDepth)
+        statistics_.maxStackDepth = depth;
+      break;
+    }
+
+    statistics_.operations++;
+    statistics_.cycles += cost(avrplc::OPERATION, argument);
+  }
+
+  std::vector<uint8_t> avrplc_;
+  unsigned stackSize_;
+  AvrCycleModel model_;
+  AvrScanStatistics statistics_;
+};
+
+#endif // !_INCLUDE_AVR_EMULATOR_H_
@@ -3,9 +3,10 @@
 
 #include <cstdint>
 
-// The PLC instructions are coded as 1 or 2 Byte
+// The PLC instructions are coded as 1, 2 or 4 Byte
 // 76543210
-// |||-----> Argument 0..30, 31 means one mor Byte allows 256 more
+// |||-----> Argument 0..30, 31 means one mor Byte allows 255 more: 31..285
+// |||       Version 2: the more Byte FF is followed by the argument 0..65535, low Byte first
 // |||
 // Instruction:
 // 000: Read Input X
@@ -20,7 +21,12 @@
 // 0: Not
 // 1: And
 // 2: Or
-// 3-31: reserved
+// 3: And Not, the top of the stack is negated: a & !b
+// 4: Or Not: a | !b
+// 5: Dup, pushes the top of the stack again
+// 6-31: reserved
+//
+// The operations 3-5 are only emitted with plc::CompileOption::FusedOperations.
 //
 // Examples:
 // 00     Read Input 0
@@ -30,6 +36,10 @@
 // 80     Not
 // 82     Or
 // A5     Write Output 5
+// DF FF 2C 01  Write Flag 300 (12C), Version 2 only
+//
+// Version 1 code is valid Version 2 code, the Versions only differ for arguments above 285.
+// Version 1 is the default, Version 2 has to be requested, e.g. by plc --avr-version 2.
 
 namespace avrplc
 {
@@ -38,6 +48,13 @@ namespace avrplc
   constexpr const uint8_t ARGUMENT_EXTENDED = 0x1f;
   constexpr const unsigned ARGUMENT_MAXIMUM = ARGUMENT_EXTENDED + 255;
 
+  constexpr const uint8_t ARGUMENT_WIDE = 0xff;
+  constexpr const unsigned ARGUMENT_WIDE_MAXIMUM = 0x10000;
+
+  constexpr const unsigned VERSION_1 = 1;
+  constexpr const unsigned VERSION_2 = 2;
+  constexpr const unsigned VERSION = VERSION_1;
+
   constexpr const uint8_t READ_INPUT = 0;
   constexpr const uint8_t READ_OUTPUT = 0x20;
   constexpr const uint8_t READ_FLAG= 0x40;
@@ -50,6 +67,9 @@ namespace avrplc
   constexpr const uint8_t NOT = 0;
   constexpr const uint8_t AND = 1;
   constexpr const uint8_t OR = 2;
+  constexpr const uint8_t AND_NOT = 3;
+  constexpr const uint8_t OR_NOT = 4;
+  constexpr const uint8_t DUP = 5;
 }
 
 #endif // _INCLUDE_AVR_PLC_H
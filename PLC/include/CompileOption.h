@@ -0,0 +1,31 @@
+#ifndef _INCLUDE_COMPILE_OPTION_H_
+#define _INCLUDE_COMPILE_OPTION_H_
+
+namespace plc
+{
+  /// <summary>
+  /// Compile Options, the passes of the PlcOptimizer
+  /// </summary>
+  enum struct CompileOption
+  {
+    // shared sub expressions are computed once and kept in a flag
+    CommonSubexpressions,
+
+    // each equation is replaced by a smaller equivalent one
+    Minimize,
+
+    // redundant instruction sequences are removed
+    Peephole,
+
+    // Peephole, with the fused operations And Not, Or Not and Dup
+    FusedOperations,
+
+    // the constant inputs of the PlcAst are folded into the equations
+    ConstantFolding,
+
+    // the flags are renumbered, the most used ones get the 1 byte indices
+    RemapFlags
+  };
+}
+
+#endif // !_INCLUDE_COMPILE_OPTION_H_
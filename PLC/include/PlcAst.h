@@ -5,9 +5,18 @@
 #include <cstdarg>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
+#include <queue>
+#include <limits>
+#include <functional>
+#include <algorithm>
 #include <stdio.h>
 
+#include <boost/utility/string_view.hpp>
+#include <boost/functional/hash.hpp>
+
 #include "PlcExpression.h"
+#include "PlcExpressionArena.h"
 #include "Variable.h"
 
 class PlcAstException : public std::exception
@@ -41,52 +50,199 @@ public:
 
   using VariableDescriptionType = std::unordered_map<std::string, Variable>;
 
+  PlcAst()
+  {
+  }
+
+  // the symbol table points into the variables
+  PlcAst(const PlcAst&) = delete;
+  PlcAst& operator=(const PlcAst&) = delete;
+
+  struct DependencyGraph
+  {
+    // the variables with an equation, ordered by name
+    std::vector<const Variable*> equations;
+    // for each equation the equations it reads, self references are left out
+    std::vector<std::vector<unsigned>> dependencies;
+  };
+
   void swap(PlcAst& other)
   {
     std::swap(variableDescription_, other.variableDescription_);
+    std::swap(variables_, other.variables_);
+    std::swap(symbols_, other.symbols_);
+    std::swap(constants_, other.constants_);
+    arena_.swap(other.arena_);
+    resolved_.swap(other.resolved_);
   }
 
+  /// <summary>
+  /// Removes all variables and destroys all expressions of the arena at once.
+  /// </summary>
   void clear()
   {
     variableDescription_.clear();
+    variables_.clear();
+    symbols_.clear();
+    constants_.clear();
+    arena_.clear();
+    resolved_.clear();
+  }
+
+  /// <summary>
+  /// Keeps the equations of the parser and the expressions inserted by resolveDependencies(),
+  /// they live until clear().
+  /// </summary>
+  plc::ExpressionArena& arena() const
+  {
+    return arena_;
+  }
+
+  /// <summary>
+  /// Ties an input permanently high or low, the compiler folds it with CompileOption::ConstantFolding.
+  /// </summary>
+  void setConstant(const std::string& name, bool value)
+  {
+    if (getVariable(name).type() != Variable::Type::Input)
+      throw PlcAstException("Variable '%s' is no input, only inputs can be constant", name.c_str());
+
+    constants_[name] = value;
+  }
+
+  void removeConstant(const std::string& name)
+  {
+    constants_.erase(name);
   }
 
-  bool variableExists(const std::string& name) const
+  const std::unordered_map<std::string, bool>& constants() const
   {
-    return variableDescription_.find(name) != variableDescription_.end();
+    return constants_;
   }
 
+  bool variableExists(boost::string_view name) const
+  {
+    return symbols_.find(name) != symbols_.end();
+  }
+
+  /// <summary>
+  /// Interns the variable: it gets the next Variable::id() and its name a symbol.
+  /// </summary>
   void addVariable(Variable&& variable)
   {
     if (variableExists(variable.name()))
       throw PlcAstException("Variable '%s' already declared", variable.name().c_str());
 
-    variableDescription_.emplace(variable.name(), std::move(variable));
+    auto inserted = variableDescription_.emplace(variable.name(), std::move(variable));
+    Variable& added = inserted.first->second;
+    added.id_ = unsigned(variables_.size());
+    variables_.emplace_back(&added);
+    symbols_.emplace(boost::string_view(inserted.first->first), added.id_);
   }
 
-  const Variable& getVariable(const std::string& name) const
+  const Variable& getVariable(boost::string_view name) const
   {
-    auto it = variableDescription_.find(name);
-    if( it == variableDescription_.end())
-      throw PlcAstException("Variable '%s' does not exist", name.c_str());
+    return *variables_[id(name)];
+  }
 
-    return it->second;
+  Variable& getVariable(boost::string_view name)
+  {
+    return *variables_[id(name)];
   }
 
-  Variable& getVariable(const std::string& name)
+  /// <summary>
+  /// The Variable::id() of a name
+  /// </summary>
+  unsigned id(boost::string_view name) const
   {
-    auto it = variableDescription_.find(name);
-    if (it == variableDescription_.end())
-      throw PlcAstException("Variable '%s' does not exist", name.c_str());
+    auto it = symbols_.find(name);
+    if (it == symbols_.end())
+      throw PlcAstException("Variable '%s' does not exist", name.to_string().c_str());
 
     return it->second;
   }
 
+  const Variable& variable(unsigned id) const
+  {
+    return *variables_[id];
+  }
+
+  /// <summary>
+  /// The number of variables, the ids are below
+  /// </summary>
+  unsigned variableCount() const
+  {
+    return unsigned(variables_.size());
+  }
+
   const VariableDescriptionType& variableDescription() const
   {
     return variableDescription_;
   }
 
+  /// <summary>
+  /// The number of reads of each variable in all equations, plus the write of its own equation,
+  /// by Variable::id()
+  /// </summary>
+  std::vector<unsigned> variableUses() const
+  {
+    std::vector<unsigned> uses(variables_.size());
+    for (const Variable *variable : variables_)
+      if (variable->expression())
+      {
+        variable->expression()->countInputs(uses);
+        uses[variable->id()]++;
+      }
+
+    return uses;
+  }
+
+  /// <summary>
+  /// Assigns an index to each flag and monoflop declared without one. The most used get the
+  /// lowest free indices: they are 1 byte AVR arguments and contiguous in the process image.
+  /// Equal uses are ordered by name.
+  /// </summary>
+  void allocateIndices()
+  {
+    std::vector<unsigned> uses;
+    for (Variable::Type type : { Variable::Type::Flag, Variable::Type::Monoflop })
+    {
+      std::vector<Variable*> pending;
+      std::vector<bool> taken;
+      for (auto it = variableDescription_.begin(); it != variableDescription_.end(); it++)
+        if (it->second.type() != type)
+          continue;
+        else if (it->second.index() == Variable::AUTO_INDEX)
+          pending.emplace_back(&it->second);
+        else
+        {
+          if (it->second.index() >= taken.size())
+            taken.resize(it->second.index() + 1);
+          taken[it->second.index()] = true;
+        }
+
+      if (pending.empty())
+        continue;
+      if (uses.empty())
+        uses = variableUses();
+
+      std::sort(pending.begin(), pending.end(), [&uses](const Variable *a, const Variable *b)
+      {
+        unsigned usesA = uses[a->id()];
+        unsigned usesB = uses[b->id()];
+        return usesA != usesB ? usesA > usesB : a->name() < b->name();
+      });
+
+      unsigned index = 0;
+      for (Variable *variable : pending)
+      {
+        while (index < taken.size() && taken[index])
+          index++;
+
+        variable->allocate(index++);
+      }
+    }
+  }
+
   unsigned maxVariableIndexOfType(Variable::Type t) const
   {
     unsigned index = 0;
@@ -97,85 +253,337 @@ public:
     return index;
   }
 
-  const plc::Expression resolveDependencies(const std::string& name, std::unordered_map<std::string,unsigned> *toSkip= nullptr) const
+  DependencyGraph dependencyGraph() const
+  {
+    DependencyGraph graph;
+    for (auto it = variableDescription_.begin(); it != variableDescription_.end(); it++)
+      if (it->second.expression())
+        graph.equations.emplace_back(&it->second);
+
+    std::sort(graph.equations.begin(), graph.equations.end(), [](const Variable *a, const Variable *b)
+    {
+      return a->name() < b->name();
+    });
+
+    // the node of each variable by id, variables without an equation have none
+    const unsigned none = std::numeric_limits<unsigned>::max();
+    std::vector<unsigned> node(variables_.size(), none);
+    for (unsigned i = 0; i < graph.equations.size(); i++)
+      node[graph.equations[i]->id()] = i;
+
+    graph.dependencies.resize(graph.equations.size());
+    std::vector<unsigned> inputs;
+    for (unsigned i = 0; i < graph.equations.size(); i++)
+    {
+      inputs.clear();
+      graph.equations[i]->expression()->inputIds(inputs);
+
+      std::vector<unsigned>& dependencies = graph.dependencies[i];
+      for (unsigned id : inputs)
+        if (node[id] != none && node[id] != i)
+          dependencies.emplace_back(node[id]);
+
+      std::sort(dependencies.begin(), dependencies.end());
+      dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+    }
+
+    return graph;
+  }
+
+  /// <summary>
+  /// The equations in evaluation order: each equation follows the equations writing
+  /// the variables it reads, otherwise they are ordered by name. Equations reading
+  /// each other in a cycle are kept together and reported in cycles, an equation
+  /// reading its own variable (a latch) is no cycle.
+  /// </summary>
+  std::vector<const Variable*> equationOrder(std::vector<std::vector<std::string>> *cycles = nullptr) const
+  {
+    DependencyGraph graph(dependencyGraph());
+    const unsigned n = unsigned(graph.equations.size());
+    const unsigned unvisited = std::numeric_limits<unsigned>::max();
+
+    // Tarjan: the strongly connected components. The search keeps its path with the next
+    // dependency of each equation on it in a vector, a long chain of equations needs no recursion.
+    std::vector<unsigned> component(n, unvisited);
+    std::vector<unsigned> index(n, unvisited);
+    std::vector<unsigned> low(n);
+    std::vector<unsigned> stack;
+    std::vector<std::pair<unsigned, unsigned>> path;
+    unsigned counter = 0;
+    unsigned components = 0;
+
+    auto visit = [&](unsigned v)
+    {
+      index[v] = low[v] = counter++;
+      stack.emplace_back(v);
+      path.emplace_back(v, 0);
+    };
+
+    for (unsigned root = 0; root < n; root++)
+    {
+      if (index[root] != unvisited)
+        continue;
+
+      visit(root);
+      while (!path.empty())
+      {
+        unsigned v = path.back().first;
+        const std::vector<unsigned>& dependencies = graph.dependencies[v];
+        if (path.back().second < dependencies.size())
+        {
+          unsigned w = dependencies[path.back().second++];
+          if (index[w] == unvisited)
+            visit(w);
+          else if (component[w] == unvisited)
+            low[v] = std::min(low[v], index[w]);
+
+          continue;
+        }
+
+        if (low[v] == index[v])
+        {
+          unsigned w;
+          do
+          {
+            w = stack.back();
+            stack.pop_back();
+            component[w] = components;
+          } while (w != v);
+
+          components++;
+        }
+
+        path.pop_back();
+        if (!path.empty())
+          low[path.back().first] = std::min(low[path.back().first], low[v]);
+      }
+    }
+
+    // Kahn on the components, the component with the smallest name first
+    std::vector<std::vector<unsigned>> members(components);
+    for (unsigned v = 0; v < n; v++)
+      members[component[v]].emplace_back(v);
+
+    std::vector<unsigned> pending(components);
+    std::vector<std::vector<unsigned>> dependents(components);
+    for (unsigned v = 0; v < n; v++)
+      for (unsigned w : graph.dependencies[v])
+        if (component[v] != component[w])
+        {
+          pending[component[v]]++;
+          dependents[component[w]].emplace_back(component[v]);
+        }
+
+    using Entry = std::pair<unsigned, unsigned>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> ready;
+    for (unsigned c = 0; c < components; c++)
+      if (!pending[c])
+        ready.emplace(members[c].front(), c);
+
+    std::vector<const Variable*> order;
+    order.reserve(n);
+    while (!ready.empty())
+    {
+      unsigned c = ready.top().second;
+      ready.pop();
+
+      for (unsigned v : members[c])
+        order.emplace_back(graph.equations[v]);
+
+      if (cycles && members[c].size() > 1)
+      {
+        cycles->emplace_back();
+        for (unsigned v : members[c])
+          cycles->back().emplace_back(graph.equations[v]->name());
+      }
+
+      for (unsigned d : dependents[c])
+        if (!--pending[d])
+          ready.emplace(members[d].front(), d);
+    }
+
+    return order;
+  }
+
+  /// <summary>
+  /// The expression of a variable with the expressions of the variables it reads inserted.
+  /// toSkip counts by Variable::id() the expressions inserted, over several calls: an
+  /// expression is inserted only once.
+  /// The result is a DAG: an inserted expression is the resolved() node of its variable, shared
+  /// by all reads of it, and a sub expression without a read of an equation is shared with the
+  /// parsed one. Nothing is copied but the nodes on the path to an inserted expression.
+  /// </summary>
+  const plc::Expression resolveDependencies(const std::string& name, std::vector<unsigned> *toSkip= nullptr) const
   {
     const Variable& variable = getVariable(name);
 
-    if (!variable.expression().operator bool())
+    if (!variable.expression())
       throw PlcAstException("Expression %s does not exist.", name.c_str());
 
-    plc::Expression all(*variable.expression());
+    const plc::Expression& expression = *variable.expression();
+    plc::Expression all(expression.id());
+    all.op() = expression.op();
+    all.setVariable(expression.variable());
 
-    resolveDependencies(all, toSkip);
+    resolveDependencies(expression, all, toSkip);
 
     return all;
   }
 
+  /// <summary>
+  /// The node inserted by resolveDependencies() for a read of the variable, created once and
+  /// cached by Variable::id() until clear(). Its terms are shared with the equation.
+  /// Although const, it adds to the arena and the cache: a PlcAst must not be used by several
+  /// threads at once, the batch mode parses one PlcAst per program.
+  /// </summary>
+  const plc::Expression& resolved(const Variable& variable) const
+  {
+    const plc::Expression *pExpression = variable.expression();
+    if (!pExpression)
+      throw PlcAstException("Expression %s does not exist.", variable.name().c_str());
+
+    if (resolved_.size() < variables_.size())
+      resolved_.resize(variables_.size());
+
+    const plc::Expression*& node = resolved_[variable.id()];
+    if (node)
+      return *node;
+
+    plc::Expression *expression = nullptr;
+    if (pExpression->terms().size() == 1)
+    {
+      plc::Term term;
+      shareTerm(pExpression->terms()[0], term);
+
+      plc::Expression::Operator op = (variable.type() == Variable::Type::Monoflop) ? plc::Expression::Operator::Timer : plc::Expression::Operator::None;
+
+      expression = arena_.create(term, op, pExpression->id());
+      expression->setVariable(pExpression->variable());
+    }
+    else
+    {
+      plc::Expression *dependency = arena_.create();
+      dependency->op() = pExpression->op();
+      for (const plc::Term& term : pExpression->terms())
+      {
+        plc::Term shared;
+        shareTerm(term, shared);
+        dependency->addTerm(shared);
+      }
+
+      plc::Term term;
+      term.share(dependency);
+
+      if (variable.type() == Variable::Type::Monoflop)
+        expression = arena_.create(term, plc::Expression::Operator::Timer, variable.index());
+      else
+        expression = arena_.create(term);
+
+      expression->setVariable(&variable);
+    }
+
+    node = expression;
+    return *node;
+  }
+
 protected:
 
-  void resolveDependencies(plc::Expression& expression, std::unordered_map<std::string, unsigned> *toSkip) const
+  /// <summary>
+  /// Adds the terms of expression to resolved: a read of an equation becomes its resolved()
+  /// node, a sub expression is copied only if it reads an equation.
+  /// </summary>
+  void resolveDependencies(const plc::Expression& expression, plc::Expression& resolvedExpression, std::vector<unsigned> *toSkip) const
   {
-    for (auto it = expression.terms_.begin(); it != expression.terms_.end(); it++)
+    for (const plc::Term& term : expression.terms())
     {
-      bool found = true;
+      plc::Term result;
 
-      switch (it->type())
+      switch (term.type())
       {
       case plc::Term::Type::Expression:
-        resolveDependencies(*it->expression().get(), toSkip);
+      {
+        const plc::Expression *sub = term.expression();
+        if (readsEquation(*sub))
+        {
+          plc::Expression *copy = arena_.create(sub->id());
+          copy->op() = sub->op();
+          copy->setVariable(sub->variable());
+          resolveDependencies(*sub, *copy, toSkip);
+          sub = copy;
+        }
+
+        result.share(sub);
         break;
+      }
 
       case plc::Term::Type::Identifier:
-        const plc::Expression *pExpression = it->variable()->expression().get();        
-        if (toSkip && pExpression)
+      {
+        const Variable *variable = term.variable();
+        bool found = variable->expression() != nullptr;
+        if (toSkip && found)
         {
-          auto skipFound = toSkip->find(it->variable()->name());
-          if (skipFound == toSkip->end())
-          {
-            (*toSkip)[it->variable()->name()] = 1;
-          }
-          else
-          {
-            skipFound->second++;
+          if (toSkip->size() < variables_.size())
+            toSkip->resize(variables_.size());
+
+          if ((*toSkip)[variable->id()]++)
             found = false;
-          }
         }
 
-        if (found && pExpression)
-        {
-          if (pExpression->terms().size() == 1)
-          {
-            plc::Term copyTerm(pExpression->terms()[0]);
+        if (found)
+          result.share(&resolved(*variable));
+        else
+          result = *variable;
+        break;
+      }
 
-            plc::Expression::Operator op = (it->variable()->type() == Variable::Type::Monoflop) ? plc::Expression::Operator::Timer : plc::Expression::Operator::None;
+      default:
+        throw PlcAstException("empty Term in expression %d", expression.id());
+      }
 
-            plc::Expression *expression = new plc::Expression(copyTerm, op, pExpression->id());
-            expression->setVariable(pExpression->variable());
-            it->setExpression(expression);
-          }
-          else
-          {
-            std::unique_ptr<plc::Expression> dep(new plc::Expression(pExpression->op(), pExpression->terms()));
-            plc::Term term(dep);
+      if (term.unary() == plc::Term::Unary::Not)
+        result.reverseUnary();
 
-            plc::Expression *expression = nullptr;
-            
-            if (it->variable()->type() == Variable::Type::Monoflop)
-              expression = new plc::Expression(term, plc::Expression::Operator::Timer, it->variable()->index());
-            else
-              expression = new plc::Expression(term);
+      resolvedExpression.addTerm(result);
+    }
+  }
 
-            expression->setVariable(it->variable());
-            it->setExpression(expression);
-          }
+  static bool readsEquation(const plc::Expression& expression)
+  {
+    for (const plc::Term& term : expression.terms())
+      if (term.type() == plc::Term::Type::Expression ? readsEquation(*term.expression()) : term.variable() && term.variable()->expression())
+        return true;
 
-        }
-        break;
-      }
-    }
+    return false;
+  }
+
+  /// <summary>
+  /// A term of an equation in a resolved() node: a sub expression is shared, not copied.
+  /// </summary>
+  static void shareTerm(const plc::Term& term, plc::Term& shared)
+  {
+    if (term.type() == plc::Term::Type::Expression)
+      shared.share(term.expression());
+    else if (term.type() == plc::Term::Type::Identifier)
+      shared = *term.variable();
+    else
+      throw PlcAstException("empty Term");
+
+    if (term.unary() == plc::Term::Unary::Not)
+      shared.reverseUnary();
   }
 
   VariableDescriptionType variableDescription_;
+  // by Variable::id()
+  std::vector<Variable*> variables_;
+  // the names are the keys of variableDescription_
+  std::unordered_map<boost::string_view, unsigned, boost::hash<boost::string_view>> symbols_;
+  // constant inputs, by name
+  std::unordered_map<std::string, bool> constants_;
+  // resolveDependencies() adds to it
+  // filled by the const resolved() and resolveDependencies() as well, not thread safe
+  mutable plc::ExpressionArena arena_;
+  // the resolved() nodes by Variable::id(), kept by arena_
+  mutable std::vector<const plc::Expression*> resolved_;
 };
 
 #endif // _INCLUDE_PLC_AST_H_
@@ -0,0 +1,230 @@
+#ifndef _INCLUDE_PLC_BATCH_H_
+#define _INCLUDE_PLC_BATCH_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+
+#include "plc.h"
+#include "PlcOptimizer.h"
+#include "PlcThreadPool.h"
+
+namespace plc
+{
+  /// <summary>
+  /// What runBatch() does with each program
+  /// </summary>
+  struct BatchOptions
+  {
+    // compile and write the AVR image <name>.bin
+    bool avr = true;
+    std::vector<CompileOption> compileOptions;
+    unsigned avrVersion = avrplc::VERSION;
+
+    // write all outputs to <name>.svg
+    bool svg = true;
+    std::vector<SVGOption> svgOptions;
+
+    // the directory of the output files, empty for the directory of each program
+    std::string outputDirectory;
+
+    // 0 threads are one per core
+    unsigned threads = 0;
+  };
+
+  /// <summary>
+  /// The result of one program of runBatch(), the error is empty if it succeeded
+  /// </summary>
+  struct BatchResult
+  {
+    std::string program;
+    std::string error;
+
+    unsigned instructions = 0;
+    unsigned bytes = 0;
+    uint64_t svgBytes = 0;
+    double seconds = 0;
+  };
+
+  struct BatchSummary
+  {
+    unsigned programs = 0;
+    unsigned failed = 0;
+    uint64_t instructions = 0;
+    uint64_t bytes = 0;
+    uint64_t svgBytes = 0;
+
+    // the time of all programs on one thread, and the elapsed time
+    double cpuSeconds = 0;
+    double seconds = 0;
+
+    unsigned threads = 0;
+    unsigned steals = 0;
+  };
+
+  /// <summary>
+  /// The output file of a program: the directory is replaced by the outputDirectory, if there is
+  /// one, and the extension of the program by the extension.
+  /// </summary>
+  inline std::string batchOutput(const std::string& program, const std::string& extension, const BatchOptions& options)
+  {
+    size_t slash = program.find_last_of("/\\");
+    size_t dot = program.find_last_of('.');
+    size_t nameStart = (slash == std::string::npos) ? 0 : slash + 1;
+    std::string stem = program.substr(0, (dot != std::string::npos && dot > nameStart) ? dot : std::string::npos);
+
+    if (options.outputDirectory.empty())
+      return stem + extension;
+
+    std::string directory = options.outputDirectory;
+    if (directory.back() != '/' && directory.back() != '\\')
+      directory += '/';
+
+    return directory + stem.substr(nameStart) + extension;
+  }
+
+  /// <summary>
+  /// Appends the files matching a pattern with * or ? in the file name, the platform code is in PlcBatch.cpp
+  /// </summary>
+  void matchFiles(const std::string& pattern, std::vector<std::string>& files);
+
+  /// <summary>
+  /// Expands the arguments of a batch to the programs: a file name is taken as it is, one with
+  /// * or ? in it is a pattern of file names, and @file a list of them, one per line.
+  /// </summary>
+  inline std::vector<std::string> expandPrograms(const std::vector<std::string>& arguments)
+  {
+    std::vector<std::string> programs;
+    for (const std::string& argument : arguments)
+    {
+      if (!argument.empty() && argument[0] == '@')
+      {
+        std::ifstream in(argument.substr(1));
+        if (!in)
+          throw PlcException("can not open '%s'", argument.c_str() + 1);
+
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(in, line))
+        {
+          size_t end = line.find_last_not_of(" \t\r");
+          if (end != std::string::npos && line[0] != '@')
+            lines.emplace_back(line.substr(0, end + 1));
+        }
+
+        std::vector<std::string> listed(expandPrograms(lines));
+        programs.insert(programs.end(), listed.begin(), listed.end());
+      }
+      else if (argument.find_first_of("*?") == std::string::npos)
+        programs.emplace_back(argument);
+      else
+      {
+        size_t matches = programs.size();
+        matchFiles(argument, programs);
+        if (programs.size() == matches)
+          throw PlcException("no program matches '%s'", argument.c_str());
+      }
+    }
+
+    return programs;
+  }
+
+  /// <summary>
+  /// Parses one program and writes its AVR image and SVG, an error is kept in the result.
+  /// </summary>
+  inline BatchResult runProgram(const std::string& program, const BatchOptions& options)
+  {
+    BatchResult result;
+    result.program = program;
+
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+      PlcAst plcAst;
+      plcParseFile(program, plcAst);
+
+      if (options.avr)
+      {
+        PlcOptimizer optimizer(plcAst, options.compileOptions, options.avrVersion);
+        std::vector<Operation> instructions;
+        optimizer.compile(instructions);
+
+        std::vector<uint8_t> avrplc;
+        translateAvr(instructions, avrplc, options.avrVersion);
+
+        std::string filename(batchOutput(program, ".bin", options));
+        std::ofstream out(filename, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(avrplc.data()), avrplc.size());
+        if (!out)
+          throw PlcException("can not write '%s'", filename.c_str());
+
+        result.instructions = optimizer.statistics().instructions;
+        result.bytes = unsigned(avrplc.size());
+      }
+
+      if (options.svg)
+      {
+        std::string filename(batchOutput(program, ".svg", options));
+        std::ofstream out(filename);
+        convert2svg(plcAst, out, options.svgOptions);
+        if (!out)
+          throw PlcException("can not write '%s'", filename.c_str());
+
+        result.svgBytes = uint64_t(out.tellp());
+      }
+    }
+    catch (std::exception& ex)
+    {
+      result.error = ex.what();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return result;
+  }
+
+  /// <summary>
+  /// Runs runProgram() for each program on a PlcThreadPool, the results are in the order of the
+  /// programs. A worker keeps only the PlcAst of the program it is working on, the memory is
+  /// bounded by the largest programs times the threads, not by the number of programs.
+  /// </summary>
+  inline std::vector<BatchResult> runBatch(const std::vector<std::string>& programs, const BatchOptions& options, BatchSummary *summary = nullptr)
+  {
+    std::vector<BatchResult> results(programs.size());
+
+    auto start = std::chrono::steady_clock::now();
+    PlcThreadPool pool(options.threads);
+    for (size_t i = 0; i < programs.size(); i++)
+      pool.submit([&results, &programs, &options, i]()
+      {
+        results[i] = runProgram(programs[i], options);
+      });
+
+    pool.wait();
+
+    if (summary)
+    {
+      *summary = BatchSummary();
+      summary->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      summary->threads = pool.size();
+      summary->steals = pool.steals();
+      for (const BatchResult& result : results)
+      {
+        summary->programs++;
+        if (!result.error.empty())
+          summary->failed++;
+
+        summary->instructions += result.instructions;
+        summary->bytes += result.bytes;
+        summary->svgBytes += result.svgBytes;
+        summary->cpuSeconds += result.seconds;
+      }
+    }
+
+    return results;
+  }
+}
+
+#endif // !_INCLUDE_PLC_BATCH_H_
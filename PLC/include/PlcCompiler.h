@@ -2,9 +2,12 @@
 #define _INCLUDE_PLC_COMPILER_H_
 
 #include <functional>
+#include <vector>
+#include <algorithm>
 
 #include "PlcAst.h"
 #include "PlcSimulator.h"
+#include "PlcFlatExpression.h"
 #include "AvrPlc.h"
 
 namespace plc
@@ -36,14 +39,104 @@ namespace plc
 
   using Emitter = std::function<void(Instruction,unsigned)>;
 
+  inline unsigned stackDepth(const Expression& expression);
+
+  inline unsigned stackDepth(const Term& term)
+  {
+    return term.type() == Term::Type::Expression ? stackDepth(*term.expression()) : 1;
+  }
+
+  /// <summary>
+  /// The terms in evaluation order: deepest first, equal depths left to right.
+  /// And/Or are commutative, the order does not change the result.
+  /// </summary>
+  inline std::vector<const Term*> evaluationOrder(const Expression& expression, std::vector<unsigned> *depths = nullptr)
+  {
+    std::vector<std::pair<unsigned, const Term*>> terms;
+    for (const Term& term : expression.terms())
+      terms.emplace_back(stackDepth(term), &term);
+
+    std::stable_sort(terms.begin(), terms.end(), [](const std::pair<unsigned, const Term*>& a, const std::pair<unsigned, const Term*>& b)
+    {
+      return a.first > b.first;
+    });
+
+    std::vector<const Term*> result;
+    for (const std::pair<unsigned, const Term*>& term : terms)
+    {
+      result.emplace_back(term.second);
+      if (depths)
+        depths->emplace_back(term.first);
+    }
+
+    return result;
+  }
+
+  /// <summary>
+  /// The stack depth needed by compile()
+  /// </summary>
+  inline unsigned stackDepth(const Expression& expression)
+  {
+    std::vector<unsigned> depths;
+    evaluationOrder(expression, &depths);
+
+    return combinedStackDepth(unsigned(depths.size()), [&depths](unsigned i) { return depths[i]; });
+  }
+
+  /// <summary>
+  /// Stack depth of each equation of an instruction stream, an equation ends with a write.
+  /// Returns the write and the maximum depth before it. A write pops only its value: one kept
+  /// by a Dup before it is still on the stack for the next equation and counts for its depth.
+  /// </summary>
+  inline std::vector<std::pair<Operation, unsigned>> stackDepths(const std::vector<Operation>& instructions)
+  {
+    std::vector<std::pair<Operation, unsigned>> result;
+    unsigned depth = 0, maxDepth = 0;
+    for (const Operation& operation : instructions)
+    {
+      switch (operation.instruction)
+      {
+      case Instruction::ReadInput:
+      case Instruction::ReadOutput:
+      case Instruction::ReadFlag:
+      case Instruction::ReadMonoflop:
+        maxDepth = std::max(maxDepth, ++depth);
+        break;
+      case Instruction::WriteOuput:
+      case Instruction::WriteFlag:
+      case Instruction::WriteMonoflop:
+        result.emplace_back(operation, maxDepth);
+        maxDepth = --depth;
+        break;
+      case Instruction::OperationAnd:
+      case Instruction::OperationOr:
+      case Instruction::OperationAndNot:
+      case Instruction::OperationOrNot:
+        depth--;
+        break;
+      case Instruction::OperationDup:
+        maxDepth = std::max(maxDepth, ++depth);
+        break;
+      default:
+        break;
+      }
+    }
+
+    return result;
+  }
+
+  /// <summary>
+  /// Compiles an expression, the deepest terms first to keep the stack small.
+  /// </summary>
   inline void compile(const PlcAst& plcAst, const Expression& expression, Emitter emitter)
   {
     bool firstTerm = true;
-    for (const plc::Term& term : expression.terms())
+    for (const plc::Term *termPointer : evaluationOrder(expression))
     {
+      const plc::Term& term = *termPointer;
       if (term.type() == Term::Type::Identifier)
       {
-        const Variable& variable = plcAst.getVariable(term.variable()->name());
+        const Variable& variable = plcAst.variable(term.variable()->id());
 
         emitter(readInstruction(variable.type()), variable.index());
         if (term.unary() == Term::Unary::Not)
@@ -52,6 +145,8 @@ namespace plc
       else if (term.type() == Term::Type::Expression)
       {
         compile(plcAst, *term.expression(), emitter);
+        if (term.unary() == Term::Unary::Not)
+          emitter(Instruction::OperationNot, 0);
       }
       else
         throw PlcAstException("empty Term");
@@ -63,74 +158,166 @@ namespace plc
     }
   }
 
+  /// <summary>
+  /// Compiles a node of a FlatExpression like the tree, depths are FlatExpression::stackDepths().
+  /// The children of the nodes being compiled are ordered on the order stack.
+  /// </summary>
+  template<typename Emit>
+  void compile(const PlcAst& plcAst, const FlatExpression& flat, unsigned node, const std::vector<unsigned>& depths, std::vector<unsigned>& order, Emit& emit)
+  {
+    if (flat.kind(node) == FlatExpression::Kind::Variable)
+    {
+      const Variable& variable = plcAst.variable(flat.variable(node));
+      emit(readInstruction(variable.type()), variable.index());
+      return;
+    }
+
+    size_t first = order.size();
+    order.insert(order.end(), flat.childrenBegin(node), flat.childrenEnd(node));
+    std::stable_sort(order.begin() + first, order.end(), [&depths](unsigned a, unsigned b)
+    {
+      return depths[a] > depths[b];
+    });
+
+    Instruction combine = flat.op(node) == Expression::Operator::And ? Instruction::OperationAnd : Instruction::OperationOr;
+    for (size_t i = first; i < first + flat.childCount(node); i++)
+    {
+      unsigned child = order[i];
+      compile(plcAst, flat, child, depths, order, emit);
+      if (flat.negated(child))
+        emit(Instruction::OperationNot, 0);
+
+      if (i != first)
+        emit(combine, 0);
+    }
+
+    order.resize(first);
+  }
+
+  /// <summary>
+  /// Compiles a FlatExpression to the same instructions as its Expression
+  /// </summary>
+  inline void compile(const PlcAst& plcAst, const FlatExpression& flat, Emitter emitter)
+  {
+    if (!flat.size())
+      return;
+
+    std::vector<unsigned> order;
+    compile(plcAst, flat, flat.root(), flat.stackDepths(), order, emitter);
+  }
+
+  /// <summary>
+  /// Compiles the equations of variables on their FlatExpressions, one after the other
+  /// reusing the arrays.
+  /// </summary>
+  inline void compile(const PlcAst& plcAst, const std::vector<const Variable*>& variables, std::vector<Operation>& instructions)
+  {
+    auto emit = [&instructions](plc::Instruction instruction, unsigned argument)
+    {
+      instructions.emplace_back(Operation{ instruction, argument });
+    };
+
+    FlatExpression flat;
+    std::vector<unsigned> depths;
+    std::vector<unsigned> order;
+    for (const Variable *variable : variables)
+    {
+      flat.lower(*variable->expression());
+      flat.stackDepths(depths);
+      compile(plcAst, flat, flat.root(), depths, order, emit);
+
+      instructions.emplace_back(Operation{ writeInstruction(variable->type()), variable->index() });
+    }
+  }
+
   inline void compile(const PlcAst& plcAst, const Expression& expression, const Variable& variable, std::vector<Operation>& instructions)
   {
-    compile(plcAst, expression, [&instructions](plc::Instruction instruction, unsigned argument) 
+    FlatExpression flat(expression);
+    compile(plcAst, flat, Emitter([&instructions](plc::Instruction instruction, unsigned argument)
     {
       instructions.emplace_back(Operation{ instruction, argument });
-    });
+    }));
 
     instructions.emplace_back(Operation{ writeInstruction(variable.type()), variable.index() });
   }
 
+  /// <summary>
+  /// Compiles all equations in PlcAst::equationOrder(), so a single scan settles
+  /// all variables not involved in a cycle.
+  /// </summary>
   inline void compile(const PlcAst& plcAst, std::vector<Operation>& instructions)
   {
-    for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
-      if(it->second.expression().operator bool())
-        plc::compile(plcAst, *it->second.expression().get(), it->second, instructions);
+    compile(plcAst, plcAst.equationOrder(), instructions);
   }
 
-  inline void avrArgument(int8_t avrOp, unsigned argument, std::vector<uint8_t>& avrplc)
+  inline void avrArgument(int8_t avrOp, unsigned argument, std::vector<uint8_t>& avrplc, unsigned version = avrplc::VERSION)
   {
-    if (argument >= avrplc::ARGUMENT_MAXIMUM)
-      throw PlcException("argument %d out of bounds, max: %d", argument, avrplc::ARGUMENT_MAXIMUM);
+    unsigned maximum = version < avrplc::VERSION_2 ? avrplc::ARGUMENT_MAXIMUM : avrplc::ARGUMENT_WIDE_MAXIMUM;
+    if (argument >= maximum)
+      throw PlcException("argument %d out of bounds, max: %d", argument, maximum);
 
     if (argument < avrplc::ARGUMENT_EXTENDED)
     {
       avrplc.emplace_back(uint8_t(avrOp + argument));
     }
-    else
+    else if (argument < avrplc::ARGUMENT_MAXIMUM)
     {
       avrplc.emplace_back(uint8_t(avrOp | avrplc::ARGUMENT_EXTENDED));
       avrplc.emplace_back(uint8_t(argument - avrplc::ARGUMENT_EXTENDED));
     }
+    else
+    {
+      avrplc.emplace_back(uint8_t(avrOp | avrplc::ARGUMENT_EXTENDED));
+      avrplc.emplace_back(avrplc::ARGUMENT_WIDE);
+      avrplc.emplace_back(uint8_t(argument));
+      avrplc.emplace_back(uint8_t(argument >> 8));
+    }
   }
 
-  inline void translateAvr(const std::vector<Operation>& instructions, std::vector<uint8_t>& avrplc)
+  inline void translateAvr(const std::vector<Operation>& instructions, std::vector<uint8_t>& avrplc, unsigned version = avrplc::VERSION)
   {
     for (const Operation& operation : instructions)
     {
       switch (operation.instruction)
       {
       case plc::Instruction::ReadInput:
-        avrArgument(avrplc::READ_INPUT, operation.argument, avrplc);
+        avrArgument(avrplc::READ_INPUT, operation.argument, avrplc, version);
         break;
       case plc::Instruction::ReadOutput:
-        avrArgument(avrplc::READ_OUTPUT, operation.argument, avrplc);
+        avrArgument(avrplc::READ_OUTPUT, operation.argument, avrplc, version);
         break;
       case plc::Instruction::ReadFlag:
-        avrArgument(avrplc::READ_FLAG, operation.argument, avrplc);
+        avrArgument(avrplc::READ_FLAG, operation.argument, avrplc, version);
         break;
       case plc::Instruction::ReadMonoflop:
-        avrArgument(avrplc::READ_MONOFLOP, operation.argument, avrplc);
+        avrArgument(avrplc::READ_MONOFLOP, operation.argument, avrplc, version);
         break;
       case plc::Instruction::WriteOuput:
-        avrArgument(avrplc::WRITE_OUTPUT, operation.argument, avrplc);
+        avrArgument(avrplc::WRITE_OUTPUT, operation.argument, avrplc, version);
         break;
       case plc::Instruction::WriteFlag:
-        avrArgument(avrplc::WRITE_FLAG, operation.argument, avrplc);
+        avrArgument(avrplc::WRITE_FLAG, operation.argument, avrplc, version);
         break;
       case plc::Instruction::WriteMonoflop:
-        avrArgument(avrplc::WRITE_MONOFLOP, operation.argument, avrplc);
+        avrArgument(avrplc::WRITE_MONOFLOP, operation.argument, avrplc, version);
         break;
       case plc::Instruction::OperationAnd:
-        avrArgument(avrplc::OPERATION, avrplc::AND, avrplc);
+        avrArgument(avrplc::OPERATION, avrplc::AND, avrplc, version);
         break;
       case plc::Instruction::OperationOr:
-        avrArgument(avrplc::OPERATION, avrplc::OR, avrplc);
+        avrArgument(avrplc::OPERATION, avrplc::OR, avrplc, version);
         break;
       case plc::Instruction::OperationNot:
-        avrArgument(avrplc::OPERATION, avrplc::NOT, avrplc);
+        avrArgument(avrplc::OPERATION, avrplc::NOT, avrplc, version);
+        break;
+      case plc::Instruction::OperationAndNot:
+        avrArgument(avrplc::OPERATION, avrplc::AND_NOT, avrplc, version);
+        break;
+      case plc::Instruction::OperationOrNot:
+        avrArgument(avrplc::OPERATION, avrplc::OR_NOT, avrplc, version);
+        break;
+      case plc::Instruction::OperationDup:
+        avrArgument(avrplc::OPERATION, avrplc::DUP, avrplc, version);
         break;
       default:
         throw PlcException("undefined Instruction: %d", int(operation.instruction));
@@ -138,6 +325,59 @@ namespace plc
     }
 
   }
+
+  /// <summary>
+  /// Decodes AVR byte code of any version back to the instructions, the reverse of translateAvr().
+  /// The address of each instruction is added to addresses, if not null. Reserved operations and
+  /// a missing extended argument throw a PlcException.
+  /// </summary>
+  inline void decodeAvr(const std::vector<uint8_t>& avrplc, std::vector<Operation>& instructions, std::vector<unsigned> *addresses = nullptr)
+  {
+    static const Instruction instructionTable[] = {
+      Instruction::ReadInput, Instruction::ReadOutput, Instruction::ReadFlag, Instruction::ReadMonoflop,
+      Instruction::OperationNot, Instruction::WriteOuput, Instruction::WriteFlag, Instruction::WriteMonoflop };
+    static const Instruction operationTable[] = {
+      Instruction::OperationNot, Instruction::OperationAnd, Instruction::OperationOr,
+      Instruction::OperationAndNot, Instruction::OperationOrNot, Instruction::OperationDup };
+
+    instructions.reserve(instructions.size() + avrplc.size());
+    const uint8_t *begin = avrplc.data();
+    const uint8_t *end = begin + avrplc.size();
+    for (const uint8_t *code = begin; code != end; code++)
+    {
+      if (addresses)
+        addresses->emplace_back(unsigned(code - begin));
+
+      uint8_t instruction = *code & avrplc::INSTRUCTION_MASK;
+      unsigned argument = *code & avrplc::ARGUMENT_MASK;
+      if (instruction == avrplc::OPERATION)
+      {
+        if (argument > avrplc::DUP)
+          throw PlcException("reserved operation %d at byte %d", argument, unsigned(code - begin));
+
+        instructions.emplace_back(Operation{ operationTable[argument], 0 });
+        continue;
+      }
+
+      if (argument == avrplc::ARGUMENT_EXTENDED)
+      {
+        if (code + 1 == end)
+          throw PlcException("extended argument missing at byte %d", unsigned(code - begin));
+
+        if (code[1] != avrplc::ARGUMENT_WIDE)
+          argument += *++code;
+        else if (end - code < 4)
+          throw PlcException("wide argument missing at byte %d", unsigned(code - begin));
+        else
+        {
+          argument = code[2] | (unsigned(code[3]) << 8);
+          code += 3;
+        }
+      }
+
+      instructions.emplace_back(Operation{ instructionTable[instruction >> 5], argument });
+    }
+  }
 };
 
 #endif // !_INCLUDE_PLC_COMPILER_H_
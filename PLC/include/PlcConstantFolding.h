@@ -0,0 +1,191 @@
+#ifndef _INCLUDE_PLC_CONSTANT_FOLDING_H_
+#define _INCLUDE_PLC_CONSTANT_FOLDING_H_
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "PlcAst.h"
+
+namespace plc
+{
+  /// <summary>
+  /// Folds the constant inputs of a PlcAst into its equations. An equation folding to false
+  /// is dropped, its variable keeps the power on value false. An equation folding to true
+  /// becomes x | !x, it still has to write its variable once. The variables of both are
+  /// constants for all later equations as well. A monoflop depends on the time, a constant
+  /// trigger leaves its equation as it is.
+  /// </summary>
+  class ConstantFolding
+  {
+  public:
+
+    enum class Result
+    {
+      False, True, Expression
+    };
+
+    ConstantFolding(const PlcAst& plcAst) : plcAst_(plcAst)
+    {
+      for (auto it = plcAst.constants().begin(); it != plcAst.constants().end(); it++)
+        constants_[&plcAst.getVariable(it->first)] = it->second;
+    }
+
+    /// <summary>
+    /// Folds the equations in place, the new expressions are owned by expressions.
+    /// Returns the number of changed equations.
+    /// </summary>
+    template<typename Equations>
+    unsigned fold(Equations& equations, std::vector<std::unique_ptr<Expression>>& expressions)
+    {
+      unsigned changed = 0;
+      for (auto it = equations.begin(); it != equations.end();)
+      {
+        const Variable& variable = *it->first;
+
+        std::unique_ptr<Expression> folded;
+        Result result = fold(*it->second, folded);
+        if (result != Result::Expression && variable.type() == Variable::Type::Monoflop)
+        {
+          it++;
+          continue;
+        }
+
+        if (result != Result::Expression)
+        {
+          constants_[&variable] = result == Result::True;
+          constantEquations_++;
+        }
+
+        if (result == Result::False)
+        {
+          it = equations.erase(it);
+          changed++;
+          continue;
+        }
+
+        if (result == Result::True)
+          folded = tautology(variable);
+
+        if (folded)
+        {
+          it->second = folded.get();
+          expressions.emplace_back(std::move(folded));
+          changed++;
+        }
+
+        it++;
+      }
+
+      return changed;
+    }
+
+    /// <summary>
+    /// Folds an expression, result is only set, if the expression changed and is not constant.
+    /// </summary>
+    Result fold(const Expression& expression, std::unique_ptr<Expression>& result) const
+    {
+      if (expression.op() == Expression::Operator::Timer)
+        return Result::Expression;
+
+      bool isAnd = expression.op() == Expression::Operator::And;
+
+      std::vector<Term> terms;
+      bool changed = false;
+      for (const Term& term : expression.terms())
+      {
+        Term folded;
+        Result value = fold(term, folded);
+        if (value == Result::Expression)
+        {
+          changed = changed || folded;
+          terms.emplace_back(folded ? folded : term);
+          continue;
+        }
+
+        changed = true;
+        // false dominates And, true dominates Or, the other one is neutral
+        if ((value == Result::True) != isAnd)
+          return value;
+      }
+
+      if (terms.empty())
+        return isAnd ? Result::True : Result::False;
+
+      if (changed)
+      {
+        result.reset(new Expression());
+        if (terms.size() > 1)
+          result->op() = expression.op();
+
+        for (Term& term : terms)
+          result->addTerm(term);
+      }
+
+      return Result::Expression;
+    }
+
+    /// <summary>
+    /// The number of equations folded to a constant by fold(equations)
+    /// </summary>
+    unsigned constantEquations() const
+    {
+      return constantEquations_;
+    }
+
+  private:
+
+    Result fold(const Term& term, Term& result) const
+    {
+      bool negated = term.unary() == Term::Unary::Not;
+
+      if (term.type() == Term::Type::Identifier)
+      {
+        auto constant = constants_.find(&plcAst_.variable(term.variable()->id()));
+        if (constant == constants_.end())
+          return Result::Expression;
+
+        return constant->second != negated ? Result::True : Result::False;
+      }
+
+      if (term.type() != Term::Type::Expression)
+        throw PlcAstException("empty Term");
+
+      std::unique_ptr<Expression> folded;
+      Result value = fold(*term.expression(), folded);
+      if (value != Result::Expression)
+        return (value == Result::True) != negated ? Result::True : Result::False;
+
+      if (folded)
+      {
+        result = folded;
+        if (negated)
+          result.reverseUnary();
+      }
+
+      return Result::Expression;
+    }
+
+    static std::unique_ptr<Expression> tautology(const Variable& variable)
+    {
+      std::unique_ptr<Expression> result(new Expression());
+      result->op() = Expression::Operator::Or;
+
+      Term term;
+      term = variable;
+      result->addTerm(term);
+
+      term = variable;
+      term.reverseUnary();
+      result->addTerm(term);
+
+      return result;
+    }
+
+    const PlcAst& plcAst_;
+    std::unordered_map<const Variable*, bool> constants_;
+    unsigned constantEquations_ = 0;
+  };
+}
+
+#endif // !_INCLUDE_PLC_CONSTANT_FOLDING_H_
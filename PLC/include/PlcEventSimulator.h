@@ -0,0 +1,177 @@
+#ifndef _INCLUDE_PLC_EVENT_SIMULATOR_H_
+#define _INCLUDE_PLC_EVENT_SIMULATOR_H_
+
+#include <queue>
+#include <functional>
+#include <algorithm>
+
+#include "PlcScanSimulator.h"
+
+/// <summary>
+/// Event driven simulation: every equation is a program of its own, a fan out index
+/// maps each variable to the equations reading it. A change re-evaluates only
+/// the affected equations, in PlcAst::equationOrder(), and propagates further changes.
+/// </summary>
+class PlcEventSimulator
+{
+public:
+
+  static constexpr const unsigned STACKSIZE = PlcScanSimulator::STACKSIZE;
+
+  /// <summary>
+  /// Each equation may be evaluated this often per change, before the
+  /// program is considered oscillating
+  /// </summary>
+  static constexpr const unsigned MAX_EVALUATIONS = 64;
+
+  PlcEventSimulator(const PlcAst& plcAst) : simulator_(plc::createSimulator(plcAst))
+  {
+    for (unsigned type = 0; type < base_.size(); type++)
+      base_[type] = type ? base_[type - 1] + simulator_.size(PlcSimulator::IOType(type - 1)) : 0;
+
+    fanOut_.resize(base_.back() + simulator_.size(PlcSimulator::IOType::Monoflop));
+
+    // the index in the evaluation order is the rank
+    std::vector<unsigned> inputs;
+    for (const Variable *variable : plcAst.equationOrder())
+    {
+      std::vector<plc::Operation> instructions;
+      plc::compile(plcAst, *variable->expression(), *variable, instructions);
+
+      inputs.clear();
+      variable->expression()->inputIds(inputs);
+      std::sort(inputs.begin(), inputs.end());
+      inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+      for (unsigned id : inputs)
+        fanOut_[key(plcAst.variable(id))].emplace_back(unsigned(equations_.size()));
+
+      equations_.emplace_back(Equation{ variable, simulator_.load(instructions) });
+    }
+
+    queued_.resize(equations_.size());
+    for (unsigned e = 0; e < equations_.size(); e++)
+      schedule(e);
+
+    propagate();
+  }
+
+  const PlcSimulator& simulator() const
+  {
+    return simulator_;
+  }
+
+  /// <summary>
+  /// The number of equation evaluations so far
+  /// </summary>
+  uint64_t evaluations() const
+  {
+    return evaluations_;
+  }
+
+  unsigned equations() const
+  {
+    return unsigned(equations_.size());
+  }
+
+  void setInput(unsigned index, bool value)
+  {
+    if (simulator_.get(PlcSimulator::IOType::Input, index) == value)
+      return;
+
+    simulator_.set(PlcSimulator::IOType::Input, index, value);
+    scheduleFanOut(base_[unsigned(PlcSimulator::IOType::Input)] + index);
+
+    propagate();
+  }
+
+  /// <summary>
+  /// Advances the monoflop timers and re-evaluates the readers of the elapsed ones.
+  /// </summary>
+  void tick(unsigned ticks)
+  {
+    unsigned monoflops = simulator_.size(PlcSimulator::IOType::Monoflop);
+
+    std::vector<bool> before(monoflops);
+    for (unsigned index = 0; index < monoflops; index++)
+      before[index] = simulator_.get(PlcSimulator::IOType::Monoflop, index);
+
+    if (!simulator_.tick(ticks))
+      return;
+
+    for (unsigned index = 0; index < monoflops; index++)
+      if (before[index] != simulator_.get(PlcSimulator::IOType::Monoflop, index))
+        scheduleFanOut(base_[unsigned(PlcSimulator::IOType::Monoflop)] + index);
+
+    propagate();
+  }
+
+private:
+
+  struct Equation
+  {
+    const Variable *variable;
+    PlcProgram program;
+  };
+
+  unsigned key(const Variable& variable) const
+  {
+    return base_[unsigned(plc::ioType(variable.type()))] + variable.index();
+  }
+
+  void schedule(unsigned e)
+  {
+    if (!queued_[e])
+    {
+      queued_[e] = true;
+      queue_.push(e);
+    }
+  }
+
+  void scheduleFanOut(unsigned k)
+  {
+    for (unsigned e : fanOut_[k])
+      schedule(e);
+  }
+
+  void propagate()
+  {
+    uint64_t limit = evaluations_ + uint64_t(MAX_EVALUATIONS) * equations_.size();
+    while (!queue_.empty())
+    {
+      unsigned e = queue_.top();
+      queue_.pop();
+      queued_[e] = false;
+
+      if (evaluations_++ == limit)
+        throw PlcException("equation '%s' does not settle", equations_[e].variable->name().c_str());
+
+      const Variable& variable = *equations_[e].variable;
+      PlcSimulator::IOType type = plc::ioType(variable.type());
+      bool before = simulator_.get(type, variable.index());
+
+      if (type == PlcSimulator::IOType::Monoflop)
+        simulator_.clearTriggered(variable.index());
+
+      simulator_.execute<STACKSIZE>(equations_[e].program);
+
+      if (before != simulator_.get(type, variable.index()))
+        scheduleFanOut(key(variable));
+    }
+  }
+
+  PlcSimulator simulator_;
+  std::vector<Equation> equations_;
+
+  // first key of each IOType
+  std::array<unsigned, 4> base_;
+  // the equations reading a variable, by key
+  std::vector<std::vector<unsigned>> fanOut_;
+
+  // equations to evaluate, by rank
+  std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> queue_;
+  std::vector<bool> queued_;
+
+  uint64_t evaluations_ = 0;
+};
+
+#endif // !_INCLUDE_PLC_EVENT_SIMULATOR_H_
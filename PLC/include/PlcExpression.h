@@ -15,6 +15,7 @@ class PlcAst;
 namespace plc
 {
   class Expression;
+  class ExpressionArena;
 
   // Term= '(' Expression ')'
   //     | !Term
@@ -43,11 +44,21 @@ namespace plc
       *this = other;
     }
 
+    Term(Term&& other) noexcept
+    {
+      swap(other);
+    }
+
     Term(std::unique_ptr<Expression>& expression)
     {
       *this = expression;
     }
 
+    ~Term()
+    {
+      release();
+    }
+
     void swap(Term& other)
     {
       Type tmp = type_;
@@ -59,6 +70,8 @@ namespace plc
       other.unary_ = utmp;
 
       std::swap(expression_, other.expression_);
+      std::swap(owned_, other.owned_);
+      std::swap(shared_, other.shared_);
       std::swap(variable_, other.variable_);
     }
 
@@ -66,7 +79,7 @@ namespace plc
     {
       type_ = Type::Empty;
       unary_ = Unary::None;
-      expression_.reset();
+      release();
       variable_ = nullptr;
     }
 
@@ -80,8 +93,7 @@ namespace plc
     void operator=(std::unique_ptr<Expression>& expression)
     {
       unary_ = Unary::None;
-      type_ = Type::Expression;
-      expression_.swap(expression);
+      setExpression(expression.release());
     }
 
     void operator=(const Term& other);
@@ -106,7 +118,12 @@ namespace plc
       return type_;
     }
 
-    const std::unique_ptr<Expression>& expression() const
+    const Expression *expression() const
+    {
+      return expression_;
+    }
+
+    Expression *expression()
     {
       return expression_;
     }
@@ -116,18 +133,36 @@ namespace plc
       return variable_;
     }
 
-    void setExpression(Expression *expression)
+    /// <summary>
+    /// Sets the sub expression, the Term deletes it unless it is kept by an ExpressionArena.
+    /// </summary>
+    void setExpression(Expression *expression);
+
+    /// <summary>
+    /// Refers to an expression kept elsewhere without owning or copying it, it has to outlive
+    /// the Term. Shared expressions make a DAG out of the terms, they are not changed.
+    /// A copy of the Term refers to the same expression.
+    /// </summary>
+    void share(const Expression *expression)
     {
-      expression_.reset(expression);
+      release();
+      expression_ = const_cast<Expression*>(expression);
+      shared_ = true;
       type_ = Type::Expression;
       variable_ = nullptr;
     }
 
   private:
 
+    void release();
+
     Unary unary_ = Unary::None;
     Type type_ = Type::Empty;
-    std::unique_ptr<Expression> expression_;
+    Expression *expression_ = nullptr;
+    // the expression is not kept by an ExpressionArena
+    bool owned_ = false;
+    // the expression is referred to by share()
+    bool shared_ = false;
     const Variable *variable_ = nullptr;
   };
 
@@ -144,7 +179,10 @@ namespace plc
       None, Or, And, Timer
     };
 
-    Expression() : id_(Expression::nextId())
+    // the id of an Expression, which is not kept by an ExpressionArena and was given none
+    static constexpr const unsigned NO_ID = ~0u;
+
+    Expression() : id_(NO_ID)
     {
     }
 
@@ -179,6 +217,7 @@ namespace plc
 
     Expression(const Expression& other)
     {
+      // a copy is never kept by the ExpressionArena of the other, a shared sub expression stays shared
       operator_ = other.operator_;
 
       terms_.reserve(other.terms_.size());
@@ -191,6 +230,8 @@ namespace plc
       variable_ = other.variable_;
     }
 
+    Expression& operator=(const Expression&) = delete;
+
     Expression(Expression&& other)
     {
       std::swap(operator_, other.operator_);
@@ -286,14 +327,42 @@ namespace plc
         }
     }
 
-    unsigned id() const
+    /// <summary>
+    /// Counts the inputs by Variable::id(), the vector grows to the highest id read.
+    /// </summary>
+    /// <param name="inputs">The input count.</param>
+    void countInputs(std::vector<unsigned>& inputs) const
     {
-      return id_;
+      for (const Term& term : terms_)
+        if (term.type() == Term::Type::Identifier)
+        {
+          unsigned id = term.variable()->id();
+          if (id >= inputs.size())
+            inputs.resize(id + 1);
+
+          inputs[id]++;
+        }
+        else if (term.type() == Term::Type::Expression)
+        {
+          term.expression()->countInputs(inputs);
+        }
+    }
+
+    /// <summary>
+    /// Appends the Variable::id() of each input, once for every occurence.
+    /// </summary>
+    void inputIds(std::vector<unsigned>& ids) const
+    {
+      for (const Term& term : terms_)
+        if (term.type() == Term::Type::Identifier)
+          ids.emplace_back(term.variable()->id());
+        else if (term.type() == Term::Type::Expression)
+          term.expression()->inputIds(ids);
     }
 
-    static unsigned lastId()
+    unsigned id() const
     {
-      return idCounter;
+      return id_;
     }
 
     const Variable *variable() const
@@ -306,25 +375,51 @@ namespace plc
       variable_ = variable;
     }
 
-  private:
-
-    static unsigned nextId()
+    /// <summary>
+    /// The expression is kept by an ExpressionArena, it is destroyed with it.
+    /// </summary>
+    bool inArena() const
     {
-      return ++idCounter;
+      return inArena_;
     }
 
+  private:
+
     friend class ::PlcAst;
+    friend class ExpressionArena;
 
     Operator operator_ = Operator::None;
     std::vector<Term> terms_;
     /// <summary>
-    /// The unique identifier
+    /// The identifier, unique in its ExpressionArena
     /// </summary>
     unsigned id_;
-    static unsigned idCounter;
 
     const Variable *variable_ = nullptr;
+    bool inArena_ = false;
   };
+
+  inline void Term::setExpression(Expression *expression)
+  {
+    if (expression != expression_)
+    {
+      release();
+      expression_ = expression;
+      owned_ = expression && !expression->inArena();
+    }
+    type_ = Type::Expression;
+    variable_ = nullptr;
+  }
+
+  inline void Term::release()
+  {
+    if (owned_)
+      delete expression_;
+
+    expression_ = nullptr;
+    owned_ = false;
+    shared_ = false;
+  }
 }
 
 std::ostream& operator<<(std::ostream& out, const plc::Expression& expression);
@@ -0,0 +1,103 @@
+#ifndef _INCLUDE_PLC_EXPRESSION_ARENA_H_
+#define _INCLUDE_PLC_EXPRESSION_ARENA_H_
+
+#include <memory>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+#include "PlcExpression.h"
+
+namespace plc
+{
+  /// <summary>
+  /// Keeps Expressions in blocks of contiguous memory, allocating one is a bump of a counter.
+  /// A Term does not delete an Expression of an ExpressionArena: clear() destroys all of them
+  /// in one pass without walking the trees, the blocks are kept for the next ones.
+  /// An Expression created without an id gets the next one of the arena, the ids of one arena
+  /// do not depend on any other one and start again after clear().
+  /// </summary>
+  class ExpressionArena
+  {
+  public:
+
+    static constexpr const size_t BLOCK_SIZE = 256;
+
+    ExpressionArena()
+    {
+    }
+
+    ExpressionArena(const ExpressionArena&) = delete;
+    ExpressionArena& operator=(const ExpressionArena&) = delete;
+
+    ~ExpressionArena()
+    {
+      clear();
+    }
+
+    template<typename... Args>
+    Expression *create(Args&&... args)
+    {
+      if (size_ == blocks_.size() * BLOCK_SIZE)
+        blocks_.emplace_back(new Storage[BLOCK_SIZE]);
+
+      Expression *expression = new (&blocks_[size_ / BLOCK_SIZE][size_ % BLOCK_SIZE]) Expression(std::forward<Args>(args)...);
+      expression->inArena_ = true;
+      if (expression->id_ == Expression::NO_ID)
+        expression->id_ = ++lastId_;
+      size_++;
+
+      return expression;
+    }
+
+    void clear()
+    {
+      for (size_t i = 0; i < size_; i++)
+        reinterpret_cast<Expression*>(&blocks_[i / BLOCK_SIZE][i % BLOCK_SIZE])->~Expression();
+
+      size_ = 0;
+      lastId_ = 0;
+    }
+
+    void swap(ExpressionArena& other)
+    {
+      std::swap(blocks_, other.blocks_);
+      std::swap(size_, other.size_);
+      std::swap(lastId_, other.lastId_);
+    }
+
+    /// <summary>
+    /// The number of Expressions
+    /// </summary>
+    size_t size() const
+    {
+      return size_;
+    }
+
+    /// <summary>
+    /// The number of Expressions, which fit into the blocks
+    /// </summary>
+    size_t capacity() const
+    {
+      return blocks_.size() * BLOCK_SIZE;
+    }
+
+    /// <summary>
+    /// The highest id given by create(), ids start at 1
+    /// </summary>
+    unsigned lastId() const
+    {
+      return lastId_;
+    }
+
+  private:
+
+    using Storage = std::aligned_storage<sizeof(Expression), alignof(Expression)>::type;
+
+    std::vector<std::unique_ptr<Storage[]>> blocks_;
+    size_t size_ = 0;
+    unsigned lastId_ = 0;
+  };
+}
+
+#endif // !_INCLUDE_PLC_EXPRESSION_ARENA_H_
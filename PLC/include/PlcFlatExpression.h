@@ -0,0 +1,323 @@
+#ifndef _INCLUDE_PLC_FLAT_EXPRESSION_H_
+#define _INCLUDE_PLC_FLAT_EXPRESSION_H_
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "PlcAst.h"
+#include "PlcSimulator.h"
+
+namespace plc
+{
+  /// <summary>
+  /// The stack depth of the operands of an And or Or in the order they are evaluated, depth(i)
+  /// is the depth of the i-th one. compile() combines each operand with the ones before at once,
+  /// so every operand after the first one finds one value on the stack.
+  /// </summary>
+  template<typename Depth>
+  inline unsigned combinedStackDepth(unsigned operands, Depth depth)
+  {
+    unsigned result = 0;
+    for (unsigned i = 0; i < operands; i++)
+      result = std::max(result, depth(i) + (i ? 1 : 0));
+
+    return result;
+  }
+
+  /// <summary>
+  /// An Expression lowered to flat arrays, one entry per node in post-order: the children of a
+  /// node precede it and the root is the last node. A node reads a variable or is an Expression
+  /// with the range of its children, in term order, in children(). Passes over it are loops over
+  /// the arrays instead of walks over the heap, the tree is only needed for parsing.
+  /// </summary>
+  class FlatExpression
+  {
+  public:
+
+    enum class Kind : uint8_t
+    {
+      Variable, Expression
+    };
+
+    // the variable of an Expression node, which is not the equation of a variable
+    static constexpr const unsigned NO_VARIABLE = Variable::NO_ID;
+
+    FlatExpression()
+    {
+    }
+
+    explicit FlatExpression(const Expression& expression)
+    {
+      lower(expression);
+    }
+
+    /// <summary>
+    /// Replaces the nodes by the lowered expression, the arrays keep their capacity
+    /// for lowering one equation after the other.
+    /// </summary>
+    void lower(const Expression& expression)
+    {
+      clear();
+      lower(expression, false);
+    }
+
+    void clear()
+    {
+      kinds_.clear();
+      ops_.clear();
+      negated_.clear();
+      variables_.clear();
+      ids_.clear();
+      first_.clear();
+      counts_.clear();
+      children_.clear();
+    }
+
+    unsigned size() const
+    {
+      return unsigned(kinds_.size());
+    }
+
+    unsigned root() const
+    {
+      return size() - 1;
+    }
+
+    Kind kind(unsigned node) const
+    {
+      return kinds_[node];
+    }
+
+    Expression::Operator op(unsigned node) const
+    {
+      return ops_[node];
+    }
+
+    /// <summary>
+    /// The node is read with a Term::Unary::Not
+    /// </summary>
+    bool negated(unsigned node) const
+    {
+      return negated_[node] != 0;
+    }
+
+    /// <summary>
+    /// The Variable::id() read by a Variable node, for an Expression node the id of the
+    /// variable it is the equation of, or NO_VARIABLE.
+    /// </summary>
+    unsigned variable(unsigned node) const
+    {
+      return variables_[node];
+    }
+
+    /// <summary>
+    /// The Expression::id() of an Expression node
+    /// </summary>
+    unsigned id(unsigned node) const
+    {
+      return ids_[node];
+    }
+
+    /// <summary>
+    /// Gives each Expression node without an id, one not created by an ExpressionArena,
+    /// the next one after lastId. Call it with ExpressionArena::lastId() of the PlcAst,
+    /// the ids of all nodes are distinct then.
+    /// </summary>
+    void assignIds(unsigned& lastId)
+    {
+      for (unsigned node = 0; node < size(); node++)
+        if (kinds_[node] == Kind::Expression && ids_[node] == Expression::NO_ID)
+          ids_[node] = ++lastId;
+    }
+
+    const unsigned *childrenBegin(unsigned node) const
+    {
+      return children_.data() + first_[node];
+    }
+
+    const unsigned *childrenEnd(unsigned node) const
+    {
+      return children_.data() + first_[node] + counts_[node];
+    }
+
+    unsigned childCount(unsigned node) const
+    {
+      return counts_[node];
+    }
+
+    /// <summary>
+    /// The stack depth of each node for compile(), like plc::stackDepth(), in one pass: the
+    /// depths of the children are known before their node, the deepest one is evaluated first.
+    /// </summary>
+    std::vector<unsigned> stackDepths() const
+    {
+      std::vector<unsigned> depths;
+      stackDepths(depths);
+
+      return depths;
+    }
+
+    void stackDepths(std::vector<unsigned>& depths) const
+    {
+      depths.resize(size());
+      std::vector<unsigned> childDepths;
+      for (unsigned node = 0; node < size(); node++)
+      {
+        if (kinds_[node] == Kind::Variable)
+        {
+          depths[node] = 1;
+          continue;
+        }
+
+        childDepths.assign(childrenBegin(node), childrenEnd(node));
+        for (unsigned& depth : childDepths)
+          depth = depths[depth];
+
+        std::sort(childDepths.begin(), childDepths.end(), [](unsigned a, unsigned b) { return a > b; });
+
+        depths[node] = combinedStackDepth(unsigned(childDepths.size()), [&childDepths](unsigned i) { return childDepths[i]; });
+      }
+    }
+
+    /// <summary>
+    /// The number of Expression levels, like Expression::countLevels()
+    /// </summary>
+    unsigned countLevels() const
+    {
+      std::vector<unsigned> levels(size());
+      for (unsigned node = 0; node < size(); node++)
+        if (kinds_[node] == Kind::Expression)
+        {
+          unsigned level = 0;
+          for (const unsigned *child = childrenBegin(node); child != childrenEnd(node); child++)
+            level = std::max(level, levels[*child]);
+
+          levels[node] = 1 + level;
+        }
+
+      return size() ? levels[root()] : 0;
+    }
+
+    /// <summary>
+    /// Counts the inputs by Variable::id(), like Expression::countInputs()
+    /// </summary>
+    void countInputs(std::vector<unsigned>& inputs) const
+    {
+      for (unsigned node = 0; node < size(); node++)
+        if (kinds_[node] == Kind::Variable)
+        {
+          if (variables_[node] >= inputs.size())
+            inputs.resize(variables_[node] + 1);
+
+          inputs[variables_[node]]++;
+        }
+    }
+
+    /// <summary>
+    /// Evaluates the expression in one pass, read(id) is the value of the variable with the
+    /// Variable::id(). A Timer is the value of its monoflop, not of its trigger.
+    /// </summary>
+    template<typename Read>
+    bool evaluate(Read read) const
+    {
+      std::vector<uint8_t> values(size());
+      for (unsigned node = 0; node < size(); node++)
+      {
+        bool value;
+        if (kinds_[node] == Kind::Variable || ops_[node] == Expression::Operator::Timer)
+          value = read(variables_[node]);
+        else
+        {
+          bool isAnd = ops_[node] == Expression::Operator::And;
+          value = isAnd;
+          for (const unsigned *child = childrenBegin(node); child != childrenEnd(node); child++)
+            value = isAnd ? (value && values[*child]) : (value || values[*child]);
+        }
+
+        values[node] = (value != negated(node)) ? 1 : 0;
+      }
+
+      return size() && values[root()];
+    }
+
+    /// <summary>
+    /// Evaluates the expression on the process image of a PlcSimulator
+    /// </summary>
+    bool evaluate(const PlcAst& plcAst, const PlcSimulator& simulator) const
+    {
+      return evaluate([&plcAst, &simulator](unsigned id)
+      {
+        const Variable& variable = plcAst.variable(id);
+        return simulator.get(ioType(variable.type()), variable.index());
+      });
+    }
+
+    static PlcSimulator::IOType ioType(Variable::Type type)
+    {
+      switch (type)
+      {
+      case Variable::Type::Input:     return PlcSimulator::IOType::Input;
+      case Variable::Type::Output:    return PlcSimulator::IOType::Output;
+      case Variable::Type::Flag:      return PlcSimulator::IOType::Flag;
+      case Variable::Type::Monoflop:  return PlcSimulator::IOType::Monoflop;
+      default:
+        throw PlcAstException("undefined Variable Type: %d", int(type));
+      }
+    }
+
+  private:
+
+    unsigned lower(const Expression& expression, bool negated)
+    {
+      // the children are collected on pending_, then moved to one range of children_
+      size_t mark = pending_.size();
+      for (const Term& term : expression.terms())
+        if (term.type() == Term::Type::Identifier)
+          pending_.emplace_back(add(Kind::Variable, Expression::Operator::None, term.unary() == Term::Unary::Not, term.variable()->id(), 0));
+        else if (term.type() == Term::Type::Expression)
+        {
+          unsigned child = lower(*term.expression(), term.unary() == Term::Unary::Not);
+          pending_.emplace_back(child);
+        }
+        else
+          throw PlcAstException("empty Term");
+
+      unsigned node = add(Kind::Expression, expression.op(), negated,
+        expression.variable() ? expression.variable()->id() : NO_VARIABLE, expression.id());
+
+      first_[node] = unsigned(children_.size());
+      counts_[node] = unsigned(pending_.size() - mark);
+      children_.insert(children_.end(), pending_.begin() + mark, pending_.end());
+      pending_.resize(mark);
+
+      return node;
+    }
+
+    unsigned add(Kind kind, Expression::Operator op, bool negated, unsigned variable, unsigned id)
+    {
+      kinds_.emplace_back(kind);
+      ops_.emplace_back(op);
+      negated_.emplace_back(negated ? 1 : 0);
+      variables_.emplace_back(variable);
+      ids_.emplace_back(id);
+      first_.emplace_back(0);
+      counts_.emplace_back(0);
+
+      return unsigned(kinds_.size() - 1);
+    }
+
+    std::vector<Kind> kinds_;
+    std::vector<Expression::Operator> ops_;
+    std::vector<uint8_t> negated_;
+    std::vector<unsigned> variables_;
+    std::vector<unsigned> ids_;
+    // the range of children of each node in children_
+    std::vector<unsigned> first_;
+    std::vector<unsigned> counts_;
+    std::vector<unsigned> children_;
+    std::vector<unsigned> pending_;
+  };
+}
+
+#endif // !_INCLUDE_PLC_FLAT_EXPRESSION_H_
@@ -0,0 +1,196 @@
+#ifndef _INCLUDE_PLC_JIT_H_
+#define _INCLUDE_PLC_JIT_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "PlcSimulator.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__unix__) || defined(__APPLE__) || defined(_WIN32))
+#define PLC_JIT 1
+#endif
+
+/// <summary>
+/// A PlcProgram translated to straight line x86-64 code. The stack is a bit stack in rax,
+/// a read is bt on the process image word followed by adc rax, rax. Writes and triggers
+/// modify the image bits directly, a trigger also sets its bit in the triggered words,
+/// the simulator restarts the timers of these monoflops afterwards.
+/// Without a x86-64 JIT, or with custom IOs installed, PlcSimulator::execute() interprets the program.
+/// </summary>
+class PlcJitProgram
+{
+public:
+
+  // the bit stack is one register
+  static constexpr const unsigned MAX_STACK_DEPTH = 64;
+
+  PlcJitProgram(PlcProgram&& program) : program_(std::move(program))
+  {
+#ifdef PLC_JIT
+    if (program_.maxStackDepth_ > MAX_STACK_DEPTH)
+      return;
+
+    std::vector<uint8_t> code;
+    translate(code);
+
+    codeSize_ = code.size();
+    function_ = reinterpret_cast<Function>(allocateCode(code));
+#endif
+  }
+
+  PlcJitProgram(const PlcJitProgram&) = delete;
+  PlcJitProgram& operator=(const PlcJitProgram&) = delete;
+
+  ~PlcJitProgram()
+  {
+#ifdef PLC_JIT
+    if (function_)
+      freeCode(reinterpret_cast<void*>(function_), codeSize_);
+#endif
+  }
+
+  /// <summary>
+  /// true, if the program is executed natively
+  /// </summary>
+  bool native() const
+  {
+    return function_ != nullptr;
+  }
+
+  size_t codeSize() const
+  {
+    return codeSize_;
+  }
+
+  const PlcProgram& program() const
+  {
+    return program_;
+  }
+
+private:
+
+  friend class PlcSimulator;
+
+  using Function = uint64_t(*)(uint64_t *image, uint64_t *triggered);
+
+  /// <summary>
+  /// Copies the code to executable memory, the platform code is in PlcJit.cpp
+  /// </summary>
+  static void *allocateCode(const std::vector<uint8_t>& code);
+  static void freeCode(void *memory, size_t size);
+
+  void translate(std::vector<uint8_t>& code) const
+  {
+#ifdef _WIN32
+    // mov r11, rcx; mov r10, rdx
+    emit(code, { 0x49, 0x89, 0xcb, 0x49, 0x89, 0xd2 });
+#else
+    // mov r11, rdi; mov r10, rsi
+    emit(code, { 0x49, 0x89, 0xfb, 0x49, 0x89, 0xf2 });
+#endif
+    // xor eax, eax
+    emit(code, { 0x31, 0xc0 });
+
+    for (const PlcProgram::Step& step : program_.steps_)
+    {
+      uint8_t bit = uint8_t(step.index % PlcSimulator::WORD_BITS);
+      switch (step.code)
+      {
+      case PlcProgram::Code::Read:
+        // bt qword [r11 + word * 8], bit; adc rax, rax
+        emit(code, { 0x49, 0x0f, 0xba, 0xa3 });
+        displacement(code, step.word);
+        emit(code, { bit, 0x48, 0x11, 0xc0 });
+        break;
+      case PlcProgram::Code::Write:
+        // mov rdx, rax; and edx, 1; shl rdx, bit; btr qword [r11 + word * 8], bit; or [r11 + word * 8], rdx; shr rax, 1
+        emit(code, { 0x48, 0x89, 0xc2, 0x83, 0xe2, 0x01, 0x48, 0xc1, 0xe2, bit, 0x49, 0x0f, 0xba, 0xb3 });
+        displacement(code, step.word);
+        emit(code, { bit, 0x49, 0x09, 0x93 });
+        displacement(code, step.word);
+        emit(code, { 0x48, 0xd1, 0xe8 });
+        break;
+      case PlcProgram::Code::Trigger:
+        // mov rdx, rax; and edx, 1; shl rdx, bit; or [r11 + word * 8], rdx; or [r10 + index / 64 * 8], rdx; shr rax, 1
+        emit(code, { 0x48, 0x89, 0xc2, 0x83, 0xe2, 0x01, 0x48, 0xc1, 0xe2, bit, 0x49, 0x09, 0x93 });
+        displacement(code, step.word);
+        emit(code, { 0x49, 0x09, 0x92 });
+        displacement(code, step.index / PlcSimulator::WORD_BITS);
+        emit(code, { 0x48, 0xd1, 0xe8 });
+        break;
+      case PlcProgram::Code::And:
+        // mov rdx, rax; shr rax, 1; or rdx, -2; and rax, rdx
+        emit(code, { 0x48, 0x89, 0xc2, 0x48, 0xd1, 0xe8, 0x48, 0x83, 0xca, 0xfe, 0x48, 0x21, 0xd0 });
+        break;
+      case PlcProgram::Code::Or:
+        // mov rdx, rax; shr rax, 1; and edx, 1; or rax, rdx
+        emit(code, { 0x48, 0x89, 0xc2, 0x48, 0xd1, 0xe8, 0x83, 0xe2, 0x01, 0x48, 0x09, 0xd0 });
+        break;
+      case PlcProgram::Code::Not:
+        // xor rax, 1
+        emit(code, { 0x48, 0x83, 0xf0, 0x01 });
+        break;
+      case PlcProgram::Code::AndNot:
+        // mov rdx, rax; not rdx; shr rax, 1; or rdx, -2; and rax, rdx
+        emit(code, { 0x48, 0x89, 0xc2, 0x48, 0xf7, 0xd2, 0x48, 0xd1, 0xe8, 0x48, 0x83, 0xca, 0xfe, 0x48, 0x21, 0xd0 });
+        break;
+      case PlcProgram::Code::OrNot:
+        // mov rdx, rax; not rdx; shr rax, 1; and edx, 1; or rax, rdx
+        emit(code, { 0x48, 0x89, 0xc2, 0x48, 0xf7, 0xd2, 0x48, 0xd1, 0xe8, 0x83, 0xe2, 0x01, 0x48, 0x09, 0xd0 });
+        break;
+      case PlcProgram::Code::Dup:
+        // mov rdx, rax; and edx, 1; add rax, rax; or rax, rdx
+        emit(code, { 0x48, 0x89, 0xc2, 0x83, 0xe2, 0x01, 0x48, 0x01, 0xc0, 0x48, 0x09, 0xd0 });
+        break;
+      }
+    }
+
+    // and eax, 1; ret
+    emit(code, { 0x83, 0xe0, 0x01, 0xc3 });
+  }
+
+  static void emit(std::vector<uint8_t>& code, std::initializer_list<uint8_t> bytes)
+  {
+    code.insert(code.end(), bytes.begin(), bytes.end());
+  }
+
+  static void displacement(std::vector<uint8_t>& code, unsigned word)
+  {
+    uint32_t offset = word * uint32_t(sizeof(uint64_t));
+    for (unsigned i = 0; i < 4; i++)
+      code.emplace_back(uint8_t(offset >> (8 * i)));
+  }
+
+  PlcProgram program_;
+  Function function_ = nullptr;
+  size_t codeSize_ = 0;
+};
+
+template<unsigned STACKSIZE>
+bool PlcSimulator::execute(const PlcJitProgram& program)
+{
+  if (!program.function_ || customIOs_)
+    return execute<STACKSIZE>(program.program_);
+
+  if (program.program_.sizes_ != size_)
+    throw PlcException("program was loaded for a different process image");
+  if (program.program_.maxStackDepth_ > STACKSIZE)
+    throw PlcException("program needs a stack size of %d, available: %d", program.program_.maxStackDepth_, STACKSIZE);
+
+  bool result = program.function_(image_.data(), triggered_.data()) != 0;
+
+  // restart the timers of the triggered monoflops
+  for (unsigned w = 0; w < triggered_.size(); w++)
+    for (uint64_t bits = triggered_[w]; bits; bits &= bits - 1)
+    {
+      unsigned index = w * WORD_BITS;
+      for (uint64_t lowest = bits & (uint64_t(0) - bits); lowest > 1; lowest >>= 1)
+        index++;
+
+      monoflopCounter_[index] = monoflopTime_[index];
+    }
+
+  return program.program_.hasResult_ && result;
+}
+
+#endif // !_INCLUDE_PLC_JIT_H_
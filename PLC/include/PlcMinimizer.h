@@ -0,0 +1,501 @@
+#ifndef _INCLUDE_PLC_MINIMIZER_H_
+#define _INCLUDE_PLC_MINIMIZER_H_
+
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+#include "PlcCompiler.h"
+#include "PlcTruthTable.h"
+
+namespace plc
+{
+  /// <summary>
+  /// Minimizes single equations. Every equation is simplified algebraically (flattening,
+  /// duplicate terms, double negations, absorption). Equations with up to MAX_EXACT_VARIABLES
+  /// variables are additionally minimized with Quine-McCluskey, the function and its complement,
+  /// the cover is factored by the most frequent literal.
+  /// A Quine-McCluskey candidate is only accepted, if a TruthTable proves it equivalent to the
+  /// original. Above MAX_EXACT_VARIABLES only the algebraic rewrites are used, they keep the
+  /// function by construction and are not checked.
+  /// </summary>
+  class Minimizer
+  {
+  public:
+
+    static constexpr const unsigned MAX_EXACT_VARIABLES = 10;
+
+    Minimizer(const PlcAst& plcAst) : plcAst_(plcAst)
+    {
+      for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
+        variables_[std::make_pair(readInstruction(it->second.type()), it->second.index())] = &it->second;
+    }
+
+    /// <summary>
+    /// Returns a smaller equivalent expression, or an empty pointer if there is none.
+    /// </summary>
+    std::unique_ptr<Expression> minimize(const Expression& equation)
+    {
+      std::vector<Operation> original(instructions(equation));
+
+      Node best(simplify(node(equation)));
+      unsigned bestSize = size(best);
+
+      std::vector<Operation> operands(readOperands(original));
+      if (operands.size() <= MAX_EXACT_VARIABLES)
+      {
+        TruthTable truthTable(original);
+
+        std::vector<uint32_t> ones, zeros;
+        truthTable.enumerate([&ones, &zeros](uint64_t firstRow, uint64_t result, unsigned lanes)
+        {
+          for (unsigned lane = 0; lane < lanes; lane++)
+            (((result >> lane) & 1) ? ones : zeros).emplace_back(uint32_t(firstRow + lane));
+        });
+
+        // constants have no instruction, they are kept as written
+        if (!ones.empty() && !zeros.empty())
+        {
+          for (int complement = 0; complement < 2; complement++)
+          {
+            Node candidate(simplify(factor(cover(complement ? zeros : ones, unsigned(operands.size())), truthTable.variables())));
+            if (complement)
+              candidate.negated = !candidate.negated;
+
+            unsigned candidateSize = size(candidate);
+            if (candidateSize < bestSize)
+            {
+              best = std::move(candidate);
+              bestSize = candidateSize;
+            }
+          }
+        }
+      }
+
+      if (bestSize >= original.size())
+        return std::unique_ptr<Expression>();
+
+      std::unique_ptr<Expression> result(expression(best));
+      if (operands.size() <= MAX_EXACT_VARIABLES && !equivalent(original, instructions(*result)))
+        return std::unique_ptr<Expression>();
+
+      return result;
+    }
+
+  private:
+
+    /// <summary>
+    /// A literal (op None) or an And/Or of the children
+    /// </summary>
+    struct Node
+    {
+      Expression::Operator op;
+      const Variable *variable;
+      bool negated;
+      std::vector<Node> children;
+    };
+
+    // a product term, bits set in mask are not part of the term
+    struct Cube
+    {
+      uint32_t value;
+      uint32_t mask;
+
+      bool operator<(const Cube& other) const
+      {
+        return mask < other.mask || (mask == other.mask && value < other.value);
+      }
+
+      bool covers(uint32_t minterm) const
+      {
+        return (minterm & ~mask) == value;
+      }
+    };
+
+    std::vector<Operation> instructions(const Expression& expression) const
+    {
+      std::vector<Operation> result;
+      compile(plcAst_, expression, [&result](Instruction instruction, unsigned argument)
+      {
+        result.emplace_back(Operation{ instruction, argument });
+      });
+
+      return result;
+    }
+
+    static std::vector<Operation> readOperands(const std::vector<Operation>& instructions)
+    {
+      std::vector<Operation> result;
+      for (const Operation& operation : instructions)
+        if (operation.instruction <= Instruction::ReadMonoflop &&
+          std::find_if(result.begin(), result.end(), [&operation](const Operation& other)
+          {
+            return other.instruction == operation.instruction && other.argument == operation.argument;
+          }) == result.end())
+          result.emplace_back(operation);
+
+      return result;
+    }
+
+    static unsigned size(const Node& node)
+    {
+      unsigned result = node.negated ? 1 : 0;
+      if (node.op == Expression::Operator::None)
+        return result + 1;
+
+      result += unsigned(node.children.size()) - 1;
+      for (const Node& child : node.children)
+        result += size(child);
+
+      return result;
+    }
+
+    static std::string key(const Node& node)
+    {
+      std::string result(node.negated ? "!" : "");
+      if (node.op == Expression::Operator::None)
+        return result + node.variable->name();
+
+      result += node.op == Expression::Operator::And ? "&(" : "|(";
+      for (const Node& child : node.children)
+        result += key(child) + ",";
+
+      return result + ")";
+    }
+
+    Node node(const Term& term) const
+    {
+      Node result;
+      if (term.type() == Term::Type::Identifier)
+        result = Node{ Expression::Operator::None, &plcAst_.variable(term.variable()->id()), false, {} };
+      else if (term.type() == Term::Type::Expression)
+        result = node(*term.expression());
+      else
+        throw PlcAstException("empty Term");
+
+      if (term.unary() == Term::Unary::Not)
+        result.negated = !result.negated;
+
+      return result;
+    }
+
+    Node node(const Expression& expression) const
+    {
+      Node result{ expression.op() == Expression::Operator::And ? Expression::Operator::And : Expression::Operator::Or, nullptr, false, {} };
+      for (const Term& term : expression.terms())
+        result.children.emplace_back(node(term));
+
+      return result;
+    }
+
+    /// <summary>
+    /// Bottom up: single children are unwrapped, children of the same operator flattened,
+    /// duplicates removed and terms absorbed: a | a & b = a, a & (a | b) = a
+    /// </summary>
+    static Node simplify(Node node)
+    {
+      if (node.op == Expression::Operator::None)
+        return node;
+
+      std::vector<Node> children;
+      for (Node& child : node.children)
+      {
+        Node simplified(simplify(std::move(child)));
+        if (simplified.op == node.op && !simplified.negated)
+          for (Node& grandChild : simplified.children)
+            children.emplace_back(std::move(grandChild));
+        else
+          children.emplace_back(std::move(simplified));
+      }
+
+      std::vector<std::string> keys;
+      std::vector<Node> unique;
+      for (Node& child : children)
+      {
+        std::string childKey(key(child));
+        if (std::find(keys.begin(), keys.end(), childKey) == keys.end())
+        {
+          keys.emplace_back(childKey);
+          unique.emplace_back(std::move(child));
+        }
+      }
+
+      // a dual child (a & b within an Or) is absorbed, if one of its terms, or all terms of
+      // an other dual child, are terms of this node
+      std::vector<std::set<std::string>> dualKeys(unique.size());
+      for (unsigned i = 0; i < unique.size(); i++)
+        if (unique[i].op != Expression::Operator::None && !unique[i].negated)
+          for (const Node& grandChild : unique[i].children)
+            dualKeys[i].insert(key(grandChild));
+
+      node.children.clear();
+      for (unsigned i = 0; i < unique.size(); i++)
+      {
+        bool absorbed = false;
+        for (unsigned j = 0; j < unique.size() && !absorbed && !dualKeys[i].empty(); j++)
+          if (j != i)
+          {
+            if (dualKeys[i].count(keys[j]))
+              absorbed = true;
+            else if (!dualKeys[j].empty() && dualKeys[j].size() <= dualKeys[i].size() &&
+              std::includes(dualKeys[i].begin(), dualKeys[i].end(), dualKeys[j].begin(), dualKeys[j].end()))
+              absorbed = dualKeys[j].size() < dualKeys[i].size() || j < i;
+          }
+
+        if (!absorbed)
+          node.children.emplace_back(std::move(unique[i]));
+      }
+
+      if (node.children.size() == 1)
+      {
+        Node child(std::move(node.children.front()));
+        child.negated = child.negated != node.negated;
+
+        return child;
+      }
+
+      return node;
+    }
+
+    /// <summary>
+    /// Quine-McCluskey: all prime implicants, the essential ones and greedily the
+    /// ones covering most of the remaining minterms.
+    /// </summary>
+    static std::vector<Cube> cover(const std::vector<uint32_t>& minterms, unsigned variables)
+    {
+      std::set<Cube> current;
+      for (uint32_t minterm : minterms)
+        current.insert(Cube{ minterm, 0 });
+
+      std::vector<Cube> primes;
+      while (!current.empty())
+      {
+        std::set<Cube> next, used;
+        for (const Cube& cube : current)
+          for (unsigned variable = 0; variable < variables; variable++)
+          {
+            uint32_t bit = 1u << variable;
+            if (!(cube.mask & bit) && !(cube.value & bit) && current.count(Cube{ cube.value | bit, cube.mask }))
+            {
+              next.insert(Cube{ cube.value, cube.mask | bit });
+              used.insert(cube);
+              used.insert(Cube{ cube.value | bit, cube.mask });
+            }
+          }
+
+        for (const Cube& cube : current)
+          if (!used.count(cube))
+            primes.emplace_back(cube);
+
+        current.swap(next);
+      }
+
+      std::vector<Cube> result;
+      std::vector<bool> covered(minterms.size());
+      for (unsigned m = 0; m < minterms.size(); m++)
+      {
+        unsigned count = 0, prime = 0;
+        for (unsigned p = 0; p < primes.size(); p++)
+          if (primes[p].covers(minterms[m]))
+          {
+            count++;
+            prime = p;
+          }
+
+        if (count == 1 && std::find_if(result.begin(), result.end(), [&primes, prime](const Cube& cube)
+          {
+            return cube.value == primes[prime].value && cube.mask == primes[prime].mask;
+          }) == result.end())
+          result.emplace_back(primes[prime]);
+      }
+
+      for (;;)
+      {
+        unsigned uncovered = 0;
+        for (unsigned m = 0; m < minterms.size(); m++)
+        {
+          covered[m] = false;
+          for (const Cube& cube : result)
+            covered[m] = covered[m] || cube.covers(minterms[m]);
+          uncovered += covered[m] ? 0 : 1;
+        }
+
+        if (!uncovered)
+          break;
+
+        unsigned best = 0, bestCount = 0;
+        for (unsigned p = 0; p < primes.size(); p++)
+        {
+          unsigned count = 0;
+          for (unsigned m = 0; m < minterms.size(); m++)
+            if (!covered[m] && primes[p].covers(minterms[m]))
+              count++;
+
+          // more covered minterms, then fewer literals
+          if (count > bestCount || (count == bestCount && count && primes[p].mask > primes[best].mask))
+          {
+            best = p;
+            bestCount = count;
+          }
+        }
+
+        result.emplace_back(primes[best]);
+      }
+
+      return result;
+    }
+
+    Node literal(const Operation& operand, bool negated) const
+    {
+      return Node{ Expression::Operator::None, variables_.at(std::make_pair(operand.instruction, operand.argument)), negated, {} };
+    }
+
+    /// <summary>
+    /// Builds the sum of the cubes, the literal common to most cubes is factored out first.
+    /// </summary>
+    Node factor(const std::vector<Cube>& cubes, const std::vector<Operation>& operands) const
+    {
+      unsigned bestCount = 0, bestVariable = 0;
+      bool bestValue = false;
+      for (unsigned variable = 0; variable < operands.size(); variable++)
+        for (int value = 1; value >= 0; value--)
+        {
+          unsigned count = 0;
+          for (const Cube& cube : cubes)
+            if (!(cube.mask & (1u << variable)) && ((cube.value >> variable) & 1) == unsigned(value))
+              count++;
+
+          if (count > bestCount)
+          {
+            bestCount = count;
+            bestVariable = variable;
+            bestValue = value != 0;
+          }
+        }
+
+      if (bestCount < 2)
+      {
+        Node sum{ Expression::Operator::Or, nullptr, false, {} };
+        for (const Cube& cube : cubes)
+        {
+          Node product{ Expression::Operator::And, nullptr, false, {} };
+          for (unsigned variable = 0; variable < operands.size(); variable++)
+            if (!(cube.mask & (1u << variable)))
+              product.children.emplace_back(literal(operands[variable], !((cube.value >> variable) & 1)));
+
+          sum.children.emplace_back(std::move(product));
+        }
+
+        return sum;
+      }
+
+      std::vector<Cube> with, without;
+      bool alone = false;
+      for (const Cube& cube : cubes)
+        if (!(cube.mask & (1u << bestVariable)) && ((cube.value >> bestVariable) & 1) == unsigned(bestValue))
+        {
+          Cube rest{ cube.value & ~(1u << bestVariable), cube.mask | (1u << bestVariable) };
+          alone = alone || rest.mask == (1u << operands.size()) - 1;
+          with.emplace_back(rest);
+        }
+        else
+          without.emplace_back(cube);
+
+      Node product{ Expression::Operator::And, nullptr, false, {} };
+      product.children.emplace_back(literal(operands[bestVariable], !bestValue));
+      if (!alone)
+        product.children.emplace_back(factor(with, operands));
+
+      if (without.empty())
+        return product;
+
+      Node sum{ Expression::Operator::Or, nullptr, false, {} };
+      sum.children.emplace_back(std::move(product));
+      sum.children.emplace_back(factor(without, operands));
+
+      return sum;
+    }
+
+    static void term(const Node& node, Term& term)
+    {
+      if (node.op == Expression::Operator::None)
+        term = *node.variable;
+      else
+      {
+        std::unique_ptr<Expression> subExpression(expression(node, false));
+        term = subExpression;
+      }
+
+      if (node.negated)
+        term.reverseUnary();
+    }
+
+    static std::unique_ptr<Expression> expression(const Node& node, bool withNegation = true)
+    {
+      std::unique_ptr<Expression> result(new Expression());
+      if (node.op == Expression::Operator::None || (withNegation && node.negated))
+      {
+        Term single;
+        term(node, single);
+        result->addTerm(single);
+
+        return result;
+      }
+
+      result->op() = node.op;
+      for (const Node& child : node.children)
+      {
+        Term childTerm;
+        term(child, childTerm);
+        result->addTerm(childTerm);
+      }
+
+      return result;
+    }
+
+    /// <summary>
+    /// original xor candidate has to be false for all inputs, a candidate with more than
+    /// MAX_EXACT_VARIABLES variables is refused
+    /// </summary>
+    bool equivalent(const std::vector<Operation>& original, const std::vector<Operation>& candidate) const
+    {
+      std::vector<Operation> operands(readOperands(original));
+      for (const Operation& operand : readOperands(candidate))
+        if (std::find_if(operands.begin(), operands.end(), [&operand](const Operation& other)
+          {
+            return other.instruction == operand.instruction && other.argument == operand.argument;
+          }) == operands.end())
+          operands.emplace_back(operand);
+
+      if (operands.size() > MAX_EXACT_VARIABLES)
+        return false;
+
+      std::vector<Operation> difference(original);
+      difference.insert(difference.end(), candidate.begin(), candidate.end());
+      difference.emplace_back(Operation{ Instruction::OperationNot, 0 });
+      difference.emplace_back(Operation{ Instruction::OperationAnd, 0 });
+      difference.insert(difference.end(), original.begin(), original.end());
+      difference.emplace_back(Operation{ Instruction::OperationNot, 0 });
+      difference.insert(difference.end(), candidate.begin(), candidate.end());
+      difference.emplace_back(Operation{ Instruction::OperationAnd, 0 });
+      difference.emplace_back(Operation{ Instruction::OperationOr, 0 });
+
+      TruthTable truthTable(difference);
+      bool different = false;
+      truthTable.enumerate([&different](uint64_t, uint64_t result, unsigned lanes)
+      {
+        different = different || (lanes < TruthTable::LANES ? result & ((uint64_t(1) << lanes) - 1) : result) != 0;
+      });
+
+      return !different;
+    }
+
+    const PlcAst& plcAst_;
+    std::map<std::pair<Instruction, unsigned>, const Variable*> variables_;
+  };
+}
+
+#endif // !_INCLUDE_PLC_MINIMIZER_H_
@@ -0,0 +1,504 @@
+#ifndef _INCLUDE_PLC_OPTIMIZER_H_
+#define _INCLUDE_PLC_OPTIMIZER_H_
+
+#include <vector>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+
+#include "CompileOption.h"
+#include "PlcCompiler.h"
+#include "PlcMinimizer.h"
+#include "PlcConstantFolding.h"
+#include "PlcRemapFlags.h"
+#include "PlcPeephole.h"
+
+namespace plc
+{
+  /// <summary>
+  /// Size of the plain and of the optimized code of a PlcOptimizer::compile() call
+  /// </summary>
+  struct CompileStatistics
+  {
+    unsigned plainInstructions = 0;
+    unsigned plainBytes = 0;
+    unsigned instructions = 0;
+    unsigned bytes = 0;
+
+    // equations simplified by constant inputs, and those of them, which are constant now
+    unsigned foldedEquations = 0;
+    unsigned constantEquations = 0;
+
+    // equations replaced by a smaller equivalent one
+    unsigned minimizedEquations = 0;
+
+    // instruction sequences rewritten by the peephole pass
+    unsigned peepholeRewrites = 0;
+
+    // sub expressions computed once and kept in a flag
+    unsigned sharedExpressions = 0;
+
+    // the flags allocated by the optimizer, above all declared flags
+    unsigned firstFlag = 0;
+    unsigned flags = 0;
+
+    // the new index of each flag, if they were remapped, and the bytes saved by it
+    std::vector<unsigned> flagMapping;
+    unsigned remapSaved = 0;
+
+    // the write of each equation and its exact stack depth, including the shared expressions
+    std::vector<std::pair<Operation, unsigned>> stackDepths;
+    unsigned maxStackDepth = 0;
+
+    int instructionsSaved() const
+    {
+      return int(plainInstructions) - int(instructions);
+    }
+
+    int bytesSaved() const
+    {
+      return int(plainBytes) - int(bytes);
+    }
+  };
+
+  /// <summary>
+  /// The equations to compile, in PlcAst::equationOrder(), a pass may replace the expression
+  /// </summary>
+  using Equations = std::vector<std::pair<const Variable*, const Expression*>>;
+
+  /// <summary>
+  /// Common sub expression elimination. All equations are hash consed into one DAG,
+  /// the terms of And/Or are sorted, so commutated sub expressions share a node.
+  /// A read is keyed by the number of writes to the variable before, so a sub expression
+  /// is only shared, as long as none of its variables is written in between.
+  /// A shared node is computed before the first equation using it and kept in a flag,
+  /// the flags are reused after the last read.
+  /// </summary>
+  class CommonSubexpressions
+  {
+  public:
+
+    CommonSubexpressions(const PlcAst& plcAst, const Equations& equations, unsigned firstFlag) : plcAst_(plcAst), firstFlag_(firstFlag)
+    {
+      std::map<std::pair<Instruction, unsigned>, unsigned> versions;
+      for (const std::pair<const Variable*, const Expression*>& equation : equations)
+      {
+        equations_.emplace_back(equation.first, literal(*equation.second, versions));
+        versions[std::make_pair(readInstruction(equation.first->type()), equation.first->index())]++;
+      }
+
+      select();
+    }
+
+    void compile(std::vector<Operation>& instructions)
+    {
+      std::vector<bool> computed(nodes_.size());
+      std::vector<size_t> temporaries;
+
+      for (const std::pair<const Variable*, unsigned>& equation : equations_)
+      {
+        unsigned node = equation.second >> 1;
+        if (shared_[node])
+          require(node, computed, temporaries, instructions);
+        else
+          prepare(node, computed, temporaries, instructions);
+
+        emit(equation.second, temporaries, instructions);
+        instructions.emplace_back(Operation{ writeInstruction(equation.first->type()), equation.first->index() });
+      }
+
+      allocate(temporaries, instructions);
+    }
+
+    /// <summary>
+    /// The number of shared sub expressions
+    /// </summary>
+    unsigned shared() const
+    {
+      return unsigned(std::count(shared_.begin(), shared_.end(), true));
+    }
+
+    /// <summary>
+    /// The number of flags used by the last compile() call
+    /// </summary>
+    unsigned flags() const
+    {
+      return flags_;
+    }
+
+  private:
+
+    struct Node
+    {
+      // Operator::None is a read
+      Expression::Operator op;
+      Instruction instruction;
+      unsigned argument;
+      unsigned version;
+      // sorted, a literal is the node index shifted left, the lowest bit negates
+      std::vector<unsigned> operands;
+
+      bool operator==(const Node& other) const
+      {
+        return op == other.op && instruction == other.instruction && argument == other.argument
+          && version == other.version && operands == other.operands;
+      }
+    };
+
+    struct NodeHash
+    {
+      size_t operator()(const Node& node) const
+      {
+        size_t hash = (size_t(node.op) << 8) ^ (size_t(node.instruction) << 4) ^ (size_t(node.argument) << 12) ^ (size_t(node.version) << 24);
+        for (unsigned operand : node.operands)
+          hash ^= std::hash<unsigned>()(operand) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+        return hash;
+      }
+    };
+
+    unsigned insert(Node&& node)
+    {
+      auto found = index_.find(node);
+      if (found != index_.end())
+        return found->second;
+
+      unsigned result = unsigned(nodes_.size());
+      index_.emplace(node, result);
+      nodes_.emplace_back(std::move(node));
+
+      return result;
+    }
+
+    unsigned literal(const Term& term, std::map<std::pair<Instruction, unsigned>, unsigned>& versions)
+    {
+      unsigned negate = term.unary() == Term::Unary::Not ? 1 : 0;
+
+      if (term.type() == Term::Type::Identifier)
+      {
+        const Variable& variable = plcAst_.variable(term.variable()->id());
+        Instruction instruction = readInstruction(variable.type());
+
+        return (insert(Node{ Expression::Operator::None, instruction, variable.index(), versions[std::make_pair(instruction, variable.index())], {} }) << 1) | negate;
+      }
+      else if (term.type() == Term::Type::Expression)
+        return literal(*term.expression(), versions) ^ negate;
+      else
+        throw PlcAstException("empty Term");
+    }
+
+    unsigned literal(const Expression& expression, std::map<std::pair<Instruction, unsigned>, unsigned>& versions)
+    {
+      if (expression.terms().size() == 1)
+        return literal(expression.terms().front(), versions);
+
+      Node node{ expression.op() == Expression::Operator::And ? Expression::Operator::And : Expression::Operator::Or, Instruction::OperationNot, 0, 0, {} };
+      for (const Term& term : expression.terms())
+        node.operands.emplace_back(literal(term, versions));
+      std::sort(node.operands.begin(), node.operands.end());
+
+      return insert(std::move(node)) << 1;
+    }
+
+    /// <summary>
+    /// A node is shared, if computing it once, writing and reading its flag is cheaper
+    /// than computing it at every reference. The operands have a lower index than the node,
+    /// so their decision is known.
+    /// </summary>
+    void select()
+    {
+      std::vector<unsigned> references(nodes_.size());
+      for (const Node& node : nodes_)
+        for (unsigned operand : node.operands)
+          references[operand >> 1]++;
+      for (const std::pair<const Variable*, unsigned>& equation : equations_)
+        references[equation.second >> 1]++;
+
+      std::vector<unsigned> cost(nodes_.size());
+      shared_.assign(nodes_.size(), false);
+      for (unsigned i = 0; i < nodes_.size(); i++)
+      {
+        const Node& node = nodes_[i];
+        if (node.op == Expression::Operator::None)
+        {
+          cost[i] = 1;
+          continue;
+        }
+
+        cost[i] = unsigned(node.operands.size()) - 1;
+        for (unsigned operand : node.operands)
+          cost[i] += (shared_[operand >> 1] ? 1 : cost[operand >> 1]) + (operand & 1);
+
+        shared_[i] = references[i] >= 2 && (references[i] - 1) * (cost[i] - 1) > 2;
+      }
+
+      // like plc::stackDepth(), the deepest operand first, a shared operand is a read
+      std::vector<unsigned> depth(nodes_.size(), 1);
+      for (unsigned i = 0; i < nodes_.size(); i++)
+      {
+        std::vector<unsigned>& operands = nodes_[i].operands;
+        auto operandDepth = [this, &depth](unsigned operand)
+        {
+          return shared_[operand >> 1] ? 1 : depth[operand >> 1];
+        };
+
+        std::stable_sort(operands.begin(), operands.end(), [&operandDepth](unsigned a, unsigned b)
+        {
+          return operandDepth(a) > operandDepth(b);
+        });
+
+        depth[i] = std::max(depth[i], combinedStackDepth(unsigned(operands.size()), [&operands, &operandDepth](unsigned j)
+        {
+          return operandDepth(operands[j]);
+        }));
+      }
+    }
+
+    void require(unsigned node, std::vector<bool>& computed, std::vector<size_t>& temporaries, std::vector<Operation>& instructions)
+    {
+      if (computed[node])
+        return;
+
+      prepare(node, computed, temporaries, instructions);
+      body(node, temporaries, instructions);
+
+      temporaries.emplace_back(instructions.size());
+      instructions.emplace_back(Operation{ Instruction::WriteFlag, node });
+      computed[node] = true;
+    }
+
+    void prepare(unsigned node, std::vector<bool>& computed, std::vector<size_t>& temporaries, std::vector<Operation>& instructions)
+    {
+      for (unsigned operand : nodes_[node].operands)
+        if (shared_[operand >> 1])
+          require(operand >> 1, computed, temporaries, instructions);
+        else
+          prepare(operand >> 1, computed, temporaries, instructions);
+    }
+
+    void body(unsigned node, std::vector<size_t>& temporaries, std::vector<Operation>& instructions)
+    {
+      const Node& n = nodes_[node];
+      if (n.op == Expression::Operator::None)
+      {
+        instructions.emplace_back(Operation{ n.instruction, n.argument });
+        return;
+      }
+
+      for (unsigned i = 0; i < n.operands.size(); i++)
+      {
+        emit(n.operands[i], temporaries, instructions);
+        if (i)
+          instructions.emplace_back(Operation{ n.op == Expression::Operator::And ? Instruction::OperationAnd : Instruction::OperationOr, 0 });
+      }
+    }
+
+    void emit(unsigned literal, std::vector<size_t>& temporaries, std::vector<Operation>& instructions)
+    {
+      if (shared_[literal >> 1])
+      {
+        temporaries.emplace_back(instructions.size());
+        instructions.emplace_back(Operation{ Instruction::ReadFlag, literal >> 1 });
+      }
+      else
+        body(literal >> 1, temporaries, instructions);
+
+      if (literal & 1)
+        instructions.emplace_back(Operation{ Instruction::OperationNot, 0 });
+    }
+
+    /// <summary>
+    /// Replaces the node numbers of the temporary reads and writes by flags,
+    /// a flag is free again after the last read of its node.
+    /// </summary>
+    void allocate(const std::vector<size_t>& temporaries, std::vector<Operation>& instructions)
+    {
+      std::unordered_map<unsigned, size_t> lastRead;
+      for (size_t position : temporaries)
+        lastRead[instructions[position].argument] = position;
+
+      std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> free;
+      std::unordered_map<unsigned, unsigned> flag;
+      flags_ = 0;
+
+      for (size_t position : temporaries)
+      {
+        Operation& operation = instructions[position];
+        unsigned node = operation.argument;
+
+        if (operation.instruction == Instruction::WriteFlag)
+        {
+          if (free.empty())
+            free.push(flags_++);
+          flag[node] = free.top();
+          free.pop();
+        }
+
+        operation.argument = firstFlag_ + flag[node];
+        if (lastRead[node] == position)
+          free.push(flag[node]);
+      }
+    }
+
+    const PlcAst& plcAst_;
+    unsigned firstFlag_;
+    unsigned flags_ = 0;
+
+    std::vector<Node> nodes_;
+    std::unordered_map<Node, unsigned, NodeHash> index_;
+    std::vector<bool> shared_;
+    std::vector<std::pair<const Variable*, unsigned>> equations_;
+  };
+
+  /// <summary>
+  /// Compiles all equations of a PlcAst with the optimizing passes selected by the CompileOptions.
+  /// The optimized code is only used, if it is not larger than the plain code of plc::compile().
+  /// The sizes are the ones of the AVR byte code version, the code is translated to.
+  /// </summary>
+  class PlcOptimizer
+  {
+  public:
+
+    PlcOptimizer(const PlcAst& plcAst, const std::initializer_list<CompileOption> options, unsigned avrVersion = avrplc::VERSION)
+      : plcAst_(plcAst), avrVersion_(avrVersion)
+    {
+      setupOptions(options.begin(), options.end());
+    }
+
+    template<typename AT>
+    PlcOptimizer(const PlcAst& plcAst, const AT& options, unsigned avrVersion = avrplc::VERSION) : plcAst_(plcAst), avrVersion_(avrVersion)
+    {
+      setupOptions(options.begin(), options.end());
+    }
+
+    bool hasOption(CompileOption option) const
+    {
+      return optionBitvector_ & (1 << static_cast<unsigned>(option));
+    }
+
+    void compile(std::vector<Operation>& instructions)
+    {
+      statistics_ = CompileStatistics();
+      for (auto it = plcAst_.variableDescription().begin(); it != plcAst_.variableDescription().end(); it++)
+        if (it->second.type() == Variable::Type::Flag && it->second.index() >= statistics_.firstFlag)
+          statistics_.firstFlag = it->second.index() + 1;
+
+      instructions.clear();
+      plc::compile(plcAst_, instructions);
+
+      std::vector<uint8_t> avrplc;
+      translateAvr(instructions, avrplc, avrVersion_);
+      statistics_.plainInstructions = statistics_.instructions = unsigned(instructions.size());
+      statistics_.plainBytes = statistics_.bytes = unsigned(avrplc.size());
+
+      if (!optionBitvector_)
+      {
+        setStackDepths(instructions);
+        return;
+      }
+
+      Equations equations;
+      for (const Variable *variable : plcAst_.equationOrder())
+        equations.emplace_back(variable, variable->expression());
+
+      CompileStatistics optimizedStatistics(statistics_);
+
+      std::vector<std::unique_ptr<Expression>> folded;
+      if (hasOption(CompileOption::ConstantFolding))
+      {
+        ConstantFolding constantFolding(plcAst_);
+        optimizedStatistics.foldedEquations = constantFolding.fold(equations, folded);
+        optimizedStatistics.constantEquations = constantFolding.constantEquations();
+      }
+
+      std::vector<std::unique_ptr<Expression>> minimized;
+      if (hasOption(CompileOption::Minimize))
+      {
+        Minimizer minimizer(plcAst_);
+        for (std::pair<const Variable*, const Expression*>& equation : equations)
+        {
+          std::unique_ptr<Expression> expression(minimizer.minimize(*equation.second));
+          if (expression)
+          {
+            equation.second = expression.get();
+            minimized.emplace_back(std::move(expression));
+          }
+        }
+
+        optimizedStatistics.minimizedEquations = unsigned(minimized.size());
+      }
+
+      std::vector<Operation> optimized;
+      if (hasOption(CompileOption::CommonSubexpressions))
+      {
+        CommonSubexpressions commonSubexpressions(plcAst_, equations, statistics_.firstFlag);
+        commonSubexpressions.compile(optimized);
+
+        optimizedStatistics.sharedExpressions = commonSubexpressions.shared();
+        optimizedStatistics.flags = commonSubexpressions.flags();
+      }
+      else
+      {
+        for (const std::pair<const Variable*, const Expression*>& equation : equations)
+          plc::compile(plcAst_, *equation.second, *equation.first, optimized);
+      }
+
+      if (hasOption(CompileOption::Peephole) || hasOption(CompileOption::FusedOperations))
+        optimizedStatistics.peepholeRewrites = peephole(optimized, hasOption(CompileOption::FusedOperations));
+
+      avrplc.clear();
+      translateAvr(optimized, avrplc, avrVersion_);
+      if (hasOption(CompileOption::RemapFlags))
+      {
+        size_t bytes = avrplc.size();
+        optimizedStatistics.flagMapping = remapFlags(optimized);
+
+        avrplc.clear();
+        translateAvr(optimized, avrplc, avrVersion_);
+        optimizedStatistics.remapSaved = unsigned(bytes - avrplc.size());
+      }
+      if (avrplc.size() <= statistics_.bytes)
+      {
+        instructions.swap(optimized);
+        statistics_ = optimizedStatistics;
+        statistics_.instructions = unsigned(instructions.size());
+        statistics_.bytes = unsigned(avrplc.size());
+      }
+
+      setStackDepths(instructions);
+    }
+
+    const CompileStatistics& statistics() const
+    {
+      return statistics_;
+    }
+
+  private:
+
+    void setStackDepths(const std::vector<Operation>& instructions)
+    {
+      statistics_.stackDepths = stackDepths(instructions);
+      for (const std::pair<Operation, unsigned>& equation : statistics_.stackDepths)
+        statistics_.maxStackDepth = std::max(statistics_.maxStackDepth, equation.second);
+    }
+
+    template <typename Iterator>
+    void setupOptions(Iterator begin, Iterator end)
+    {
+      unsigned tmp = 0;
+      for (auto it = begin; it != end; it++)
+        tmp |= 1 << static_cast<unsigned>(*it);
+
+      optionBitvector_ = tmp;
+    }
+
+    const PlcAst& plcAst_;
+    unsigned avrVersion_;
+    unsigned optionBitvector_ = 0;
+    CompileStatistics statistics_;
+  };
+}
+
+#endif // !_INCLUDE_PLC_OPTIMIZER_H_
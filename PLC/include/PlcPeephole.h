@@ -0,0 +1,70 @@
+#ifndef _INCLUDE_PLC_PEEPHOLE_H_
+#define _INCLUDE_PLC_PEEPHOLE_H_
+
+#include <vector>
+
+#include "PlcSimulator.h"
+
+namespace plc
+{
+  inline bool sameVariable(const Operation& read, const Operation& write)
+  {
+    // a monoflop write triggers, reading it afterwards is not the written value
+    return read.argument == write.argument &&
+      ((read.instruction == Instruction::ReadOutput && write.instruction == Instruction::WriteOuput) ||
+      (read.instruction == Instruction::ReadFlag && write.instruction == Instruction::WriteFlag));
+  }
+
+  /// <summary>
+  /// Rewrites an instruction stream, each instruction is matched against the already rewritten tail:
+  /// Read X, Write X and Not, Not are removed. With fused operations Not, And becomes AndNot,
+  /// Not, Or becomes OrNot and Write X, Read X becomes Dup, Write X.
+  /// </summary>
+  /// <returns>The number of rewrites</returns>
+  inline unsigned peephole(std::vector<Operation>& instructions, bool fused)
+  {
+    std::vector<Operation> result;
+    result.reserve(instructions.size());
+
+    unsigned rewrites = 0;
+    for (const Operation& operation : instructions)
+    {
+      if (!result.empty())
+      {
+        Operation& last = result.back();
+        if (sameVariable(last, operation) ||
+          (last.instruction == Instruction::OperationNot && operation.instruction == Instruction::OperationNot))
+        {
+          result.pop_back();
+          rewrites++;
+          continue;
+        }
+
+        if (fused && last.instruction == Instruction::OperationNot &&
+          (operation.instruction == Instruction::OperationAnd || operation.instruction == Instruction::OperationOr))
+        {
+          last.instruction = operation.instruction == Instruction::OperationAnd ? Instruction::OperationAndNot : Instruction::OperationOrNot;
+          rewrites++;
+          continue;
+        }
+
+        if (fused && sameVariable(operation, last))
+        {
+          Operation write(last);
+          last = Operation{ Instruction::OperationDup, 0 };
+          result.emplace_back(write);
+          rewrites++;
+          continue;
+        }
+      }
+
+      result.emplace_back(operation);
+    }
+
+    instructions.swap(result);
+
+    return rewrites;
+  }
+}
+
+#endif // !_INCLUDE_PLC_PEEPHOLE_H_
@@ -0,0 +1,51 @@
+#ifndef _INCLUDE_PLC_REMAP_FLAGS_H_
+#define _INCLUDE_PLC_REMAP_FLAGS_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "PlcSimulator.h"
+
+namespace plc
+{
+  /// <summary>
+  /// Renumbers the flags of an instruction stream by their number of reads and writes, the most
+  /// used flag gets index 0. Flags are internal to the program, inputs, outputs and monoflops
+  /// are wired or configured by index and keep it. The indices below 31 cost 1 byte in the AVR
+  /// code, below 286 2 bytes, so this order gives the smallest code.
+  /// </summary>
+  /// <returns>The new index of each old flag index, an unused flag gets ~0u</returns>
+  inline std::vector<unsigned> remapFlags(std::vector<Operation>& instructions)
+  {
+    std::vector<unsigned> uses;
+    for (const Operation& operation : instructions)
+      if (operation.instruction == Instruction::ReadFlag || operation.instruction == Instruction::WriteFlag)
+      {
+        if (operation.argument >= uses.size())
+          uses.resize(operation.argument + 1);
+        uses[operation.argument]++;
+      }
+
+    std::vector<unsigned> order;
+    for (unsigned flag = 0; flag < uses.size(); flag++)
+      if (uses[flag])
+        order.emplace_back(flag);
+
+    std::stable_sort(order.begin(), order.end(), [&uses](unsigned a, unsigned b)
+    {
+      return uses[a] > uses[b];
+    });
+
+    std::vector<unsigned> mapping(uses.size(), ~0u);
+    for (unsigned index = 0; index < order.size(); index++)
+      mapping[order[index]] = index;
+
+    for (Operation& operation : instructions)
+      if (operation.instruction == Instruction::ReadFlag || operation.instruction == Instruction::WriteFlag)
+        operation.argument = mapping[operation.argument];
+
+    return mapping;
+  }
+}
+
+#endif // !_INCLUDE_PLC_REMAP_FLAGS_H_
@@ -0,0 +1,254 @@
+#ifndef _INCLUDE_PLC_SCAN_SIMULATOR_H_
+#define _INCLUDE_PLC_SCAN_SIMULATOR_H_
+
+#include <istream>
+#include <sstream>
+#include <functional>
+#include <algorithm>
+#include <limits>
+
+#include "PlcCompiler.h"
+
+namespace plc
+{
+  /// <summary>
+  /// The monoflop times are counted in 2 second ticks, see PlcParser::parseVariables
+  /// </summary>
+  constexpr const unsigned TICK_MS = 2000;
+
+  struct InputEvent
+  {
+    uint64_t ms;
+    unsigned input;
+    bool value;
+  };
+
+  /// <summary>
+  /// Reads input changes, one per line: milliseconds input-name 0|1
+  /// Empty lines and lines starting with '#' are ignored. The result is ordered by time.
+  /// </summary>
+  inline std::vector<InputEvent> readInputEvents(std::istream& in, const PlcAst& plcAst)
+  {
+    std::vector<InputEvent> events;
+
+    std::string line;
+    for (unsigned lineNumber = 1; std::getline(in, line); lineNumber++)
+    {
+      std::istringstream fields(line);
+
+      uint64_t ms;
+      std::string name;
+      unsigned value;
+      if (!(fields >> ms))
+      {
+        fields.clear();
+        char c = 0;
+        if (!(fields >> c) || c == '#')
+          continue;
+
+        throw PlcException("line %d: missing time", lineNumber);
+      }
+
+      if (!(fields >> name >> value) || value > 1)
+        throw PlcException("line %d: expected 'milliseconds input 0|1'", lineNumber);
+
+      const Variable& variable = plcAst.getVariable(name);
+      if (variable.type() != Variable::Type::Input)
+        throw PlcException("line %d: '%s' is not an input", lineNumber, name.c_str());
+
+      events.emplace_back(InputEvent{ ms, variable.index(), value != 0 });
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const InputEvent& a, const InputEvent& b)
+    {
+      return a.ms < b.ms;
+    });
+
+    return events;
+  }
+
+  inline PlcSimulator::IOType ioType(Variable::Type type)
+  {
+    switch (type)
+    {
+    case Variable::Type::Input:     return PlcSimulator::IOType::Input;
+    case Variable::Type::Output:    return PlcSimulator::IOType::Output;
+    case Variable::Type::Monoflop:  return PlcSimulator::IOType::Monoflop;
+    case Variable::Type::Flag:      return PlcSimulator::IOType::Flag;
+    default:
+      throw PlcAstException("undefined Variable Type: %d", int(type));
+    }
+  }
+
+  /// <summary>
+  /// A PlcSimulator sized for the variables of the program, with the monoflop times set.
+  /// </summary>
+  inline PlcSimulator createSimulator(const PlcAst& plcAst)
+  {
+    PlcSimulator simulator(1 + plcAst.maxVariableIndexOfType(Variable::Type::Input)
+      , 1 + plcAst.maxVariableIndexOfType(Variable::Type::Output)
+      , 1 + plcAst.maxVariableIndexOfType(Variable::Type::Flag)
+      , 1 + plcAst.maxVariableIndexOfType(Variable::Type::Monoflop));
+
+    for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
+      if (it->second.type() == Variable::Type::Monoflop)
+        simulator.setMonoflopTime(it->second.index(), it->second.time());
+
+    return simulator;
+  }
+}
+
+/// <summary>
+/// Cycle accurate simulation of a whole program: every scan runs all equations once,
+/// the monoflops elapse in ticks like on the AVR. The time is kept in milliseconds,
+/// ticks happen at multiples of TICK_MS. Between input changes the process image is
+/// settled, so the simulation jumps directly to the next event or the next elapsing
+/// monoflop instead of ticking through idle time.
+/// </summary>
+class PlcScanSimulator
+{
+public:
+
+  static constexpr const unsigned STACKSIZE = 64;
+  static constexpr const unsigned MAX_SETTLE_SCANS = 64;
+
+  /// <summary>
+  /// Called after the process image was settled at the given time
+  /// </summary>
+  using Observer = std::function<void(uint64_t ms, const PlcSimulator& simulator)>;
+
+  PlcScanSimulator(const PlcAst& plcAst) : simulator_(plc::createSimulator(plcAst))
+  {
+    std::vector<plc::Operation> instructions;
+    plc::compile(plcAst, instructions);
+    program_ = simulator_.load(instructions);
+
+    settle();
+  }
+
+  PlcSimulator& simulator()
+  {
+    return simulator_;
+  }
+
+  const PlcSimulator& simulator() const
+  {
+    return simulator_;
+  }
+
+  /// <summary>
+  /// The simulated time in milliseconds
+  /// </summary>
+  uint64_t now() const
+  {
+    return now_;
+  }
+
+  /// <summary>
+  /// The number of scan cycles executed
+  /// </summary>
+  uint64_t scans() const
+  {
+    return scans_;
+  }
+
+  bool stable() const
+  {
+    return stable_;
+  }
+
+  void setInput(unsigned index, bool value)
+  {
+    simulator_.set(PlcSimulator::IOType::Input, index, value);
+    stable_ = false;
+  }
+
+  void scan()
+  {
+    simulator_.clearTriggered();
+    simulator_.execute<STACKSIZE>(program_);
+    scans_++;
+  }
+
+  /// <summary>
+  /// Scans until the process image does not change any more.
+  /// Returns false, if it is still changing after MAX_SETTLE_SCANS.
+  /// </summary>
+  bool settle()
+  {
+    for (unsigned i = 0; i < MAX_SETTLE_SCANS; i++)
+    {
+      previous_ = simulator_.image();
+      scan();
+      if (previous_ == simulator_.image())
+        return stable_ = true;
+    }
+
+    return stable_ = false;
+  }
+
+  /// <summary>
+  /// Advances the time. While the process image is stable, only elapsing monoflops
+  /// can change it, so the time jumps from one expiry to the next.
+  /// </summary>
+  void advance(uint64_t ms, Observer observer = Observer())
+  {
+    uint64_t target = now_ + ms;
+    for (;;)
+    {
+      uint64_t ticks = target / plc::TICK_MS - now_ / plc::TICK_MS;
+      if (!ticks)
+        break;
+
+      uint64_t step = 1;
+      if (stable_)
+        step = std::min<uint64_t>(std::min<uint64_t>(ticks, simulator_.nextExpiry()), std::numeric_limits<unsigned>::max());
+
+      bool elapsed = simulator_.tick(unsigned(step));
+      now_ = (now_ / plc::TICK_MS + step) * plc::TICK_MS;
+
+      if (elapsed || !stable_)
+      {
+        settle();
+        if (observer)
+          observer(now_, simulator_);
+      }
+    }
+
+    now_ = target;
+  }
+
+  /// <summary>
+  /// Replays input events ordered by time, the observer is called whenever
+  /// the process image was settled.
+  /// </summary>
+  void replay(const std::vector<plc::InputEvent>& events, Observer observer = Observer())
+  {
+    for (auto it = events.begin(); it != events.end();)
+    {
+      if (it->ms < now_)
+        throw PlcException("input event at %llu ms is in the past", (unsigned long long)it->ms);
+
+      advance(it->ms - now_, observer);
+
+      for (; it != events.end() && it->ms == now_; it++)
+        setInput(it->input, it->value);
+
+      settle();
+      if (observer)
+        observer(now_, simulator_);
+    }
+  }
+
+private:
+
+  PlcSimulator simulator_;
+  PlcProgram program_;
+
+  std::vector<uint64_t> previous_;
+  uint64_t now_ = 0;
+  uint64_t scans_ = 0;
+  bool stable_ = false;
+};
+
+#endif // !_INCLUDE_PLC_SCAN_SIMULATOR_H_
@@ -3,6 +3,9 @@
 
 #include <array>
 #include <vector>
+#include <memory>
+#include <cstdint>
+#include <limits>
 
 #include "Stack.h"
 #include "PlcException.h"
@@ -10,6 +13,8 @@
 class IO
 {
 public:
+
+  virtual ~IO() {}
   
   virtual operator bool() const
   {
@@ -31,7 +36,9 @@ namespace plc
   {
     ReadInput, ReadOutput, ReadFlag, ReadMonoflop,
     WriteOuput, WriteFlag, WriteMonoflop,
-    OperationAnd, OperationOr, OperationNot
+    OperationAnd, OperationOr, OperationNot,
+    // fused operations, the top of the stack is negated before And/Or, Dup pushes the top again
+    OperationAndNot, OperationOrNot, OperationDup
   };
 
   struct Operation
@@ -41,6 +48,68 @@ namespace plc
   };
 }
 
+class PlcSimulator;
+class PlcJitProgram;
+class PlcThreadedProgram;
+
+/// <summary>
+/// An instruction stream prepared by PlcSimulator::load(). All operands are
+/// validated and resolved to their word and bit in the process image, the
+/// maximum stack depth is known, so execution needs no checks at all.
+/// </summary>
+class PlcProgram
+{
+public:
+
+  enum class Code : uint8_t
+  {
+    Read, Write, Trigger, And, Or, Not, AndNot, OrNot, Dup
+  };
+
+  struct Step
+  {
+    Code code;
+    uint8_t type;
+    unsigned index;
+    unsigned word;
+    uint64_t mask;
+  };
+
+  const std::vector<Step>& steps() const
+  {
+    return steps_;
+  }
+
+  unsigned maxStackDepth() const
+  {
+    return maxStackDepth_;
+  }
+
+  /// <summary>
+  /// true, if the program leaves one value on the stack, i.e. it ends with an expression.
+  /// </summary>
+  bool hasResult() const
+  {
+    return hasResult_;
+  }
+
+private:
+
+  friend class PlcSimulator;
+  friend class PlcJitProgram;
+  friend class PlcThreadedProgram;
+
+  std::vector<Step> steps_;
+  std::array<unsigned, 4> sizes_;
+  unsigned maxStackDepth_ = 0;
+  bool hasResult_ = false;
+};
+
+/// <summary>
+/// Simulates the PLC on a packed process image: every IOType is a contiguous
+/// bitset, all of them share one word array. Custom IO subclasses may be installed
+/// per index with setIO(), they overlay the packed bit.
+/// </summary>
 class PlcSimulator
 {
 public:
@@ -50,93 +119,486 @@ public:
     Input, Output, Flag, Monoflop
   };
 
+  static constexpr const unsigned WORD_BITS = 64;
+
   PlcSimulator(unsigned inputs, unsigned outputs, unsigned flags, unsigned monoflops)
   {
-    processImage[unsigned(IOType::Input)].resize(inputs);
-    processImage[unsigned(IOType::Output)].resize(outputs);
-    processImage[unsigned(IOType::Flag)].resize(flags);
-    processImage[unsigned(IOType::Monoflop)].resize(monoflops);
+    std::array<unsigned, 4> sizes{ { inputs, outputs, flags, monoflops } };
+
+    unsigned words = 0;
+    for (unsigned type = 0; type < sizes.size(); type++)
+    {
+      size_[type] = sizes[type];
+      base_[type] = words;
+      words += (sizes[type] + WORD_BITS - 1) / WORD_BITS;
+
+      ios_[type].resize(sizes[type]);
+    }
+
+    image_.resize(words);
+    custom_.resize(words);
+
+    monoflopTime_.resize(monoflops);
+    monoflopCounter_.resize(monoflops);
+    triggered_.resize((monoflops + WORD_BITS - 1) / WORD_BITS);
   }
 
   IO& io(IOType type, unsigned index)
   {
-    std::vector<std::unique_ptr<IO>>& ios = processImage[unsigned(type)];
-
-    if (index >= ios.size())
-      throw PlcException("index %d for type %d out out bounds (%d)"
-        , index, unsigned(type), ios.size());
+    checkIndex(type, index);
 
-    std::unique_ptr<IO>& io = ios[index];
+    std::unique_ptr<IO>& io = ios_[unsigned(type)][index];
     if (!io)
     {
       // Factory!
-      io.reset(new IO());
+      io.reset(new PackedIO(image_[word(type, index)], mask(index)));
     }
 
     return *io;
   }
 
+  /// <summary>
+  /// Installs a custom IO, which replaces the packed bit for reading and writing.
+  /// Passing an empty pointer removes the overlay.
+  /// </summary>
+  void setIO(IOType type, unsigned index, std::unique_ptr<IO> io)
+  {
+    checkIndex(type, index);
+
+    uint64_t& custom = custom_[word(type, index)];
+    if (custom & mask(index))
+      customIOs_--;
+
+    if (io)
+    {
+      custom |= mask(index);
+      customIOs_++;
+    }
+    else
+      custom &= ~mask(index);
+
+    ios_[unsigned(type)][index].swap(io);
+  }
+
+  bool get(IOType type, unsigned index) const
+  {
+    checkIndex(type, index);
+
+    return read<true>(type, index);
+  }
+
+  void set(IOType type, unsigned index, bool value)
+  {
+    checkIndex(type, index);
+
+    write<true>(type, index, value);
+  }
+
+  unsigned size(IOType type) const
+  {
+    return size_[unsigned(type)];
+  }
+
+  const std::vector<uint64_t>& image() const
+  {
+    return image_;
+  }
+
+  /// <summary>
+  /// Sets the time of a monoflop in ticks (half seconds). Writing true to a timed
+  /// monoflop triggers it: it reads true until the time has elapsed, every further
+  /// write of true restarts the time, writing false has no effect.
+  /// A time of 0 makes it a plain flag. Programs must be loaded after this call.
+  /// </summary>
+  void setMonoflopTime(unsigned index, unsigned ticks)
+  {
+    checkIndex(IOType::Monoflop, index);
+
+    monoflopTime_[index] = ticks;
+  }
+
+  /// <summary>
+  /// Writes a monoflop like a program does: a timed monoflop is triggered by true,
+  /// false has no effect. A monoflop without time is written as a flag.
+  /// </summary>
+  void trigger(unsigned index, bool value)
+  {
+    checkIndex(IOType::Monoflop, index);
+
+    if (!monoflopTime_[index])
+      write<true>(IOType::Monoflop, index, value);
+    else if (value)
+    {
+      write<true>(IOType::Monoflop, index, true);
+      monoflopCounter_[index] = monoflopTime_[index];
+      triggered_[index / WORD_BITS] |= mask(index);
+    }
+  }
+
+  /// <summary>
+  /// Forgets, which monoflops were triggered, call before a scan cycle.
+  /// </summary>
+  void clearTriggered()
+  {
+    std::fill(triggered_.begin(), triggered_.end(), 0);
+  }
+
+  void clearTriggered(unsigned index)
+  {
+    checkIndex(IOType::Monoflop, index);
+
+    triggered_[index / WORD_BITS] &= ~mask(index);
+  }
+
+  /// <summary>
+  /// The number of ticks until the next running monoflop elapses. Monoflops triggered
+  /// since clearTriggered() are excluded, they are restarted by every scan.
+  /// </summary>
+  unsigned nextExpiry() const
+  {
+    unsigned next = std::numeric_limits<unsigned>::max();
+    for (unsigned index = 0; index < monoflopCounter_.size(); index++)
+      if (monoflopCounter_[index] && monoflopCounter_[index] < next && !(triggered_[index / WORD_BITS] & mask(index)))
+        next = monoflopCounter_[index];
+
+    return next;
+  }
+
+  /// <summary>
+  /// Advances the monoflop timers, monoflops triggered since clearTriggered()
+  /// keep their time. Returns true, if at least one monoflop elapsed.
+  /// </summary>
+  bool tick(unsigned ticks)
+  {
+    bool elapsed = false;
+    for (unsigned index = 0; index < monoflopCounter_.size(); index++)
+    {
+      unsigned& counter = monoflopCounter_[index];
+      if (!counter || (triggered_[index / WORD_BITS] & mask(index)))
+        continue;
+
+      if (counter > ticks)
+      {
+        counter -= ticks;
+      }
+      else
+      {
+        counter = 0;
+        write<true>(IOType::Monoflop, index, false);
+        elapsed = true;
+      }
+    }
+
+    return elapsed;
+  }
+
   void resetAll()
   {
-    for (auto& it : processImage)
-      for (auto& io : it)
-        if (io)
-          *io = false;
+    std::fill(image_.begin(), image_.end(), 0);
+    std::fill(monoflopCounter_.begin(), monoflopCounter_.end(), 0);
+    clearTriggered();
+
+    if (customIOs_)
+      for (auto& it : ios_)
+        for (auto& io : it)
+          if (io)
+            *io = false;
   }
 
-  template<unsigned STACKSIZE>
-  bool execute(const std::vector<plc::Operation>& instructions)
+  /// <summary>
+  /// Validates the instructions against the size of this process image and
+  /// prepares them for execution.
+  /// </summary>
+  PlcProgram load(const std::vector<plc::Operation>& instructions) const
   {
-    Stack<bool, STACKSIZE> stack;
+    PlcProgram program;
+    program.sizes_ = size_;
+    program.steps_.reserve(instructions.size());
+
+    unsigned depth = 0;
     for (const plc::Operation& operation : instructions)
     {
+      PlcProgram::Step step{ PlcProgram::Code::Read, 0, 0, 0, 0 };
       switch (operation.instruction)
       {
       case plc::Instruction::ReadInput:
-        stack.push(io(IOType::Input, operation.argument));
+        operand(step, IOType::Input, operation.argument);
         break;
       case plc::Instruction::ReadOutput:
-        stack.push(io(IOType::Output, operation.argument));
+        operand(step, IOType::Output, operation.argument);
         break;
       case plc::Instruction::ReadFlag:
-        stack.push(io(IOType::Flag, operation.argument));
+        operand(step, IOType::Flag, operation.argument);
         break;
       case plc::Instruction::ReadMonoflop:
-        stack.push(io(IOType::Monoflop, operation.argument));
+        operand(step, IOType::Monoflop, operation.argument);
         break;
       case plc::Instruction::WriteOuput:
-        io(IOType::Output, operation.argument) = stack.pop();
+        step.code = PlcProgram::Code::Write;
+        operand(step, IOType::Output, operation.argument);
         break;
       case plc::Instruction::WriteFlag:
-        io(IOType::Flag, operation.argument) = stack.pop();
+        step.code = PlcProgram::Code::Write;
+        operand(step, IOType::Flag, operation.argument);
         break;
       case plc::Instruction::WriteMonoflop:
-        io(IOType::Monoflop, operation.argument) = stack.pop();
+        operand(step, IOType::Monoflop, operation.argument);
+        step.code = monoflopTime_[operation.argument] ? PlcProgram::Code::Trigger : PlcProgram::Code::Write;
         break;
       case plc::Instruction::OperationAnd:
-        stack.push(stack.pop() & stack.pop());
+        step.code = PlcProgram::Code::And;
         break;
       case plc::Instruction::OperationOr:
-        stack.push(stack.pop() | stack.pop());
+        step.code = PlcProgram::Code::Or;
         break;
       case plc::Instruction::OperationNot:
-        stack.push(!stack.pop());
+        step.code = PlcProgram::Code::Not;
+        break;
+      case plc::Instruction::OperationAndNot:
+        step.code = PlcProgram::Code::AndNot;
+        break;
+      case plc::Instruction::OperationOrNot:
+        step.code = PlcProgram::Code::OrNot;
+        break;
+      case plc::Instruction::OperationDup:
+        step.code = PlcProgram::Code::Dup;
         break;
       default:
-        std::cout << "UNDEFINED: " << int(operation.instruction) << std::endl;
+        throw PlcException("undefined Instruction: %d", int(operation.instruction));
       }
+
+      unsigned pops = stackPops(step.code);
+      unsigned pushes = stackPushes(step.code);
+      if (depth < pops)
+        throw PlcException("stack underflow at instruction %d", unsigned(program.steps_.size()));
+
+      depth += pushes - pops;
+      if (depth > program.maxStackDepth_)
+        program.maxStackDepth_ = depth;
+
+      program.steps_.emplace_back(step);
     }
 
-    if (stack.size() != 1)
-      throw PlcException("internal Error, stack size= %d", stack.size());
+    if (depth > 1)
+      throw PlcException("%d values left on the stack", depth);
+
+    program.hasResult_ = depth == 1;
+
+    return program;
+  }
+
+  template<unsigned STACKSIZE>
+  bool execute(const PlcProgram& program)
+  {
+    if (program.sizes_ != size_)
+      throw PlcException("program was loaded for a different process image");
+    if (program.maxStackDepth_ > STACKSIZE)
+      throw PlcException("program needs a stack size of %d, available: %d", program.maxStackDepth_, STACKSIZE);
+
+    if (customIOs_)
+      return execute<STACKSIZE, true>(program);
+    else
+      return execute<STACKSIZE, false>(program);
+  }
+
+  /// <summary>
+  /// Executes natively compiled code, defined in PlcJit.h
+  /// </summary>
+  template<unsigned STACKSIZE>
+  bool execute(const PlcJitProgram& program);
+
+  /// <summary>
+  /// Executes pre-decoded handlers on a bit stack, defined in PlcThreaded.h
+  /// </summary>
+  template<unsigned STACKSIZE>
+  bool execute(const PlcThreadedProgram& program);
+
+  template<unsigned STACKSIZE>
+  bool execute(const std::vector<plc::Operation>& instructions)
+  {
+    PlcProgram program(load(instructions));
+    if (!program.hasResult())
+      throw PlcException("internal Error, stack size= %d", 0);
 
-    return stack.pop();
+    return execute<STACKSIZE>(program);
   }
 
 private:
 
-  std::array<std::vector<std::unique_ptr<IO>>, 4> processImage;
+  class PackedIO : public IO
+  {
+  public:
+
+    PackedIO(uint64_t& word, uint64_t mask) : word_(word), mask_(mask) {}
+
+    virtual operator bool() const override
+    {
+      return (word_ & mask_) != 0;
+    }
+
+    virtual void operator =(bool value) override
+    {
+      if (value)
+        word_ |= mask_;
+      else
+        word_ &= ~mask_;
+    }
+
+  private:
+    uint64_t& word_;
+    uint64_t mask_;
+  };
+
+  void checkIndex(IOType type, unsigned index) const
+  {
+    if (index >= size_[unsigned(type)])
+      throw PlcException("index %d for type %d out out bounds (%d)"
+        , index, unsigned(type), size_[unsigned(type)]);
+  }
+
+  unsigned word(IOType type, unsigned index) const
+  {
+    return base_[unsigned(type)] + index / WORD_BITS;
+  }
+
+  static uint64_t mask(unsigned index)
+  {
+    return uint64_t(1) << (index % WORD_BITS);
+  }
+
+  template<bool OVERLAY>
+  bool read(IOType type, unsigned index) const
+  {
+    unsigned w = word(type, index);
+    if (OVERLAY && (custom_[w] & mask(index)))
+      return *ios_[unsigned(type)][index];
+
+    return (image_[w] & mask(index)) != 0;
+  }
+
+  template<bool OVERLAY>
+  void write(IOType type, unsigned index, bool value)
+  {
+    unsigned w = word(type, index);
+    if (OVERLAY && (custom_[w] & mask(index)))
+      *ios_[unsigned(type)][index] = value;
+    else if (value)
+      image_[w] |= mask(index);
+    else
+      image_[w] &= ~mask(index);
+  }
+
+  static unsigned stackPops(PlcProgram::Code code)
+  {
+    switch (code)
+    {
+    case PlcProgram::Code::Read:  return 0;
+    case PlcProgram::Code::Write: return 1;
+    case PlcProgram::Code::Trigger: return 1;
+    case PlcProgram::Code::Not:   return 1;
+    case PlcProgram::Code::Dup:   return 1;
+    default:                      return 2;
+    }
+  }
+
+  static unsigned stackPushes(PlcProgram::Code code)
+  {
+    if (code == PlcProgram::Code::Dup)
+      return 2;
+
+    return (code == PlcProgram::Code::Write || code == PlcProgram::Code::Trigger) ? 0 : 1;
+  }
+
+  void operand(PlcProgram::Step& step, IOType type, unsigned index) const
+  {
+    checkIndex(type, index);
+
+    step.type = uint8_t(type);
+    step.index = index;
+    step.word = word(type, index);
+    step.mask = mask(index);
+  }
+
+  template<unsigned STACKSIZE, bool OVERLAY>
+  bool execute(const PlcProgram& program)
+  {
+    bool stack[STACKSIZE];
+    bool *top = stack;
+
+    uint64_t *image = image_.data();
+    for (const PlcProgram::Step& step : program.steps_)
+    {
+      switch (step.code)
+      {
+      case PlcProgram::Code::Read:
+        if (OVERLAY)
+          *top++ = read<true>(IOType(step.type), step.index);
+        else
+          *top++ = (image[step.word] & step.mask) != 0;
+        break;
+      case PlcProgram::Code::Write:
+        --top;
+        if (OVERLAY)
+          write<true>(IOType(step.type), step.index, *top);
+        else
+          image[step.word] = (image[step.word] & ~step.mask) | ((uint64_t(0) - uint64_t(*top)) & step.mask);
+        break;
+      case PlcProgram::Code::Trigger:
+        if (*--top)
+        {
+          if (OVERLAY)
+            write<true>(IOType::Monoflop, step.index, true);
+          else
+            image[step.word] |= step.mask;
+
+          monoflopCounter_[step.index] = monoflopTime_[step.index];
+          triggered_[step.index / WORD_BITS] |= step.mask;
+        }
+        break;
+      case PlcProgram::Code::And:
+        --top;
+        top[-1] = top[-1] & *top;
+        break;
+      case PlcProgram::Code::Or:
+        --top;
+        top[-1] = top[-1] | *top;
+        break;
+      case PlcProgram::Code::Not:
+        top[-1] = !top[-1];
+        break;
+      case PlcProgram::Code::AndNot:
+        --top;
+        top[-1] = top[-1] & !*top;
+        break;
+      case PlcProgram::Code::OrNot:
+        --top;
+        top[-1] = top[-1] | !*top;
+        break;
+      case PlcProgram::Code::Dup:
+        *top = top[-1];
+        ++top;
+        break;
+      }
+    }
+
+    return program.hasResult_ && stack[0];
+  }
+
+  // one word array for all IOTypes, each type starts at a word boundary
+  std::vector<uint64_t> image_;
+  // bit set, if the IO at that position is a custom overlay
+  std::vector<uint64_t> custom_;
+  std::array<unsigned, 4> base_;
+  std::array<unsigned, 4> size_;
+
+  std::array<std::vector<std::unique_ptr<IO>>, 4> ios_;
+  unsigned customIOs_ = 0;
+
+  // monoflop timers in ticks
+  std::vector<unsigned> monoflopTime_;
+  std::vector<unsigned> monoflopCounter_;
+  // bit set, if the monoflop was triggered since clearTriggered()
+  std::vector<uint64_t> triggered_;
 };
 
 #endif // !_INCLUDE_PLC_SIMULATOR_H_
-
@@ -0,0 +1,215 @@
+#ifndef _INCLUDE_PLC_THREAD_POOL_H_
+#define _INCLUDE_PLC_THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <algorithm>
+
+/// <summary>
+/// A fixed number of worker threads with a work stealing queue each. A task submitted by a
+/// worker goes to its own queue, any other task round robin to the queues. A worker takes the
+/// newest task of its own queue and steals the oldest one of another queue, when its own is
+/// empty, so long and short tasks even out over the workers.
+/// </summary>
+class PlcThreadPool
+{
+public:
+
+  using Task = std::function<void()>;
+
+  /// <summary>
+  /// 0 threads are one per core
+  /// </summary>
+  explicit PlcThreadPool(unsigned threads = 0)
+  {
+    if (!threads)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 0; i < threads; i++)
+      queues_.emplace_back(new Queue());
+
+    for (unsigned i = 0; i < threads; i++)
+      threads_.emplace_back([this, i]() { run(i); });
+  }
+
+  PlcThreadPool(const PlcThreadPool&) = delete;
+  PlcThreadPool& operator=(const PlcThreadPool&) = delete;
+
+  /// <summary>
+  /// Finishes the submitted tasks and joins the workers
+  /// </summary>
+  ~PlcThreadPool()
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_.wait(lock, [this]() { return !pending_; });
+      stop_ = true;
+    }
+    available_.notify_all();
+
+    for (std::thread& thread : threads_)
+      thread.join();
+  }
+
+  void submit(Task task)
+  {
+    unsigned index = (worker().pool == this) ? worker().index : unsigned(next_++ % queues_.size());
+    {
+      // counted first, a worker may take the task as soon as it is queued
+      std::lock_guard<std::mutex> lock(mutex_);
+      queued_++;
+      pending_++;
+    }
+    {
+      std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+      queues_[index]->tasks.emplace_back(std::move(task));
+    }
+    available_.notify_one();
+  }
+
+  /// <summary>
+  /// Blocks until all submitted tasks are done, rethrows the first exception of a task.
+  /// It must not be called by a task.
+  /// </summary>
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return !pending_; });
+
+    if (exception_)
+    {
+      std::exception_ptr exception = exception_;
+      exception_ = nullptr;
+      std::rethrow_exception(exception);
+    }
+  }
+
+  unsigned size() const
+  {
+    return unsigned(threads_.size());
+  }
+
+  /// <summary>
+  /// The number of tasks taken from the queue of another worker
+  /// </summary>
+  unsigned steals() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return steals_;
+  }
+
+private:
+
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // the pool and queue of the current thread, if it is a worker
+  struct Worker
+  {
+    const PlcThreadPool *pool;
+    unsigned index;
+  };
+
+  static Worker& worker()
+  {
+    static thread_local Worker current{ nullptr, 0 };
+
+    return current;
+  }
+
+  void run(unsigned index)
+  {
+    worker() = Worker{ this, index };
+
+    for (;;)
+    {
+      Task task;
+      bool stolen = false;
+      if (!take(index, task, stolen))
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        available_.wait(lock, [this]() { return queued_ || stop_; });
+        if (stop_ && !queued_)
+          return;
+
+        continue;
+      }
+
+      std::exception_ptr exception;
+      try
+      {
+        task();
+      }
+      catch (...)
+      {
+        exception = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (exception && !exception_)
+        exception_ = exception;
+      if (stolen)
+        steals_++;
+      if (!--pending_)
+        done_.notify_all();
+    }
+  }
+
+  bool take(unsigned index, Task& task, bool& stolen)
+  {
+    for (unsigned i = 0; i < queues_.size(); i++)
+    {
+      Queue& queue = *queues_[(index + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty())
+        continue;
+
+      if (i)
+      {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+      else
+      {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      }
+
+      stolen = i != 0;
+      std::lock_guard<std::mutex> countLock(mutex_);
+      queued_--;
+
+      return true;
+    }
+
+    return false;
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+
+  mutable std::mutex mutex_;
+  // a task was queued or the pool stops
+  std::condition_variable available_;
+  // all tasks are done
+  std::condition_variable done_;
+  // tasks in the queues, and those not finished yet
+  unsigned queued_ = 0;
+  unsigned pending_ = 0;
+  unsigned steals_ = 0;
+  std::atomic<unsigned> next_{ 0 };
+  bool stop_ = false;
+  std::exception_ptr exception_;
+};
+
+#endif // !_INCLUDE_PLC_THREAD_POOL_H_
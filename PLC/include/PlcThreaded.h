@@ -0,0 +1,193 @@
+#ifndef _INCLUDE_PLC_THREADED_H_
+#define _INCLUDE_PLC_THREADED_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "PlcSimulator.h"
+
+/// <summary>
+/// A PlcProgram pre-decoded to an array of cells, every cell carries the resolved word and bit.
+/// The stack is a uint64_t bit stack, the top is bit 0, so every operation is a shift and a
+/// mask without any memory access. With GCC and Clang the cells are dispatched by computed
+/// goto, each handler jumps directly to the next one, other compilers call a handler pointer
+/// per cell. With custom IOs installed PlcSimulator::execute() interprets the program.
+/// </summary>
+class PlcThreadedProgram
+{
+public:
+
+  // the bit stack is one word
+  static constexpr const unsigned MAX_STACK_DEPTH = 64;
+
+  PlcThreadedProgram(PlcProgram&& program) : program_(std::move(program))
+  {
+    if (program_.maxStackDepth_ > MAX_STACK_DEPTH)
+      throw PlcException("program needs a stack size of %d, the bit stack has: %d", program_.maxStackDepth_, MAX_STACK_DEPTH);
+
+    cells_.reserve(program_.steps_.size() + 1);
+    for (const PlcProgram::Step& step : program_.steps_)
+      cells_.emplace_back(Cell{ handler(step.code), uint8_t(step.code), step.word, step.index % PlcSimulator::WORD_BITS, step.index });
+
+    cells_.emplace_back(Cell{ nullptr, END, 0, 0, 0 });
+  }
+
+  const PlcProgram& program() const
+  {
+    return program_;
+  }
+
+private:
+
+  friend class PlcSimulator;
+
+  struct Context
+  {
+    uint64_t *image;
+    uint64_t *triggered;
+    unsigned *counter;
+    const unsigned *time;
+  };
+
+  struct Cell;
+  using Handler = uint64_t(*)(uint64_t stack, const Cell& cell, const Context& context);
+
+  // the code of the last cell
+  static constexpr const uint8_t END = uint8_t(PlcProgram::Code::Dup) + 1;
+
+  struct Cell
+  {
+    Handler handler;
+    uint8_t code;
+    unsigned word;
+    unsigned bit;
+    unsigned index;
+  };
+
+  static uint64_t read(uint64_t stack, const Cell& cell, const Context& context)
+  {
+    return (stack << 1) | ((context.image[cell.word] >> cell.bit) & 1);
+  }
+
+  static uint64_t write(uint64_t stack, const Cell& cell, const Context& context)
+  {
+    uint64_t& word = context.image[cell.word];
+    word = (word & ~(uint64_t(1) << cell.bit)) | ((stack & 1) << cell.bit);
+
+    return stack >> 1;
+  }
+
+  static uint64_t trigger(uint64_t stack, const Cell& cell, const Context& context)
+  {
+    if (stack & 1)
+    {
+      context.image[cell.word] |= uint64_t(1) << cell.bit;
+      context.counter[cell.index] = context.time[cell.index];
+      context.triggered[cell.index / PlcSimulator::WORD_BITS] |= uint64_t(1) << cell.bit;
+    }
+
+    return stack >> 1;
+  }
+
+  static uint64_t operationAnd(uint64_t stack, const Cell&, const Context&)
+  {
+    return (stack >> 1) & (stack | ~uint64_t(1));
+  }
+
+  static uint64_t operationOr(uint64_t stack, const Cell&, const Context&)
+  {
+    return (stack >> 1) | (stack & 1);
+  }
+
+  static uint64_t operationNot(uint64_t stack, const Cell&, const Context&)
+  {
+    return stack ^ 1;
+  }
+
+  static uint64_t operationAndNot(uint64_t stack, const Cell&, const Context&)
+  {
+    return (stack >> 1) & ~(stack & 1);
+  }
+
+  static uint64_t operationOrNot(uint64_t stack, const Cell&, const Context&)
+  {
+    return (stack >> 1) | (~stack & 1);
+  }
+
+  static uint64_t operationDup(uint64_t stack, const Cell&, const Context&)
+  {
+    return (stack << 1) | (stack & 1);
+  }
+
+  static Handler handler(PlcProgram::Code code)
+  {
+    switch (code)
+    {
+    case PlcProgram::Code::Read:    return read;
+    case PlcProgram::Code::Write:   return write;
+    case PlcProgram::Code::Trigger: return trigger;
+    case PlcProgram::Code::And:     return operationAnd;
+    case PlcProgram::Code::Or:      return operationOr;
+    case PlcProgram::Code::Not:     return operationNot;
+    case PlcProgram::Code::AndNot:  return operationAndNot;
+    case PlcProgram::Code::OrNot:   return operationOrNot;
+    case PlcProgram::Code::Dup:     return operationDup;
+    default:
+      throw PlcException("undefined Code: %d", int(code));
+    }
+  }
+
+  PlcProgram program_;
+  std::vector<Cell> cells_;
+};
+
+template<unsigned STACKSIZE>
+bool PlcSimulator::execute(const PlcThreadedProgram& program)
+{
+  if (customIOs_)
+    return execute<STACKSIZE>(program.program_);
+
+  if (program.program_.sizes_ != size_)
+    throw PlcException("program was loaded for a different process image");
+  if (program.program_.maxStackDepth_ > STACKSIZE)
+    throw PlcException("program needs a stack size of %d, available: %d", program.program_.maxStackDepth_, STACKSIZE);
+
+  const PlcThreadedProgram::Context context{ image_.data(), triggered_.data(), monoflopCounter_.data(), monoflopTime_.data() };
+
+  uint64_t stack = 0;
+  const PlcThreadedProgram::Cell *cell = program.cells_.data();
+
+#if defined(__GNUC__)
+  // same order as PlcProgram::Code, END last
+  static const void *labels[] = { &&read, &&write, &&trigger, &&operationAnd, &&operationOr, &&operationNot,
+    &&operationAndNot, &&operationOrNot, &&operationDup, &&end };
+
+#define PLC_THREADED_HANDLER(name) \
+  name: \
+    stack = PlcThreadedProgram::name(stack, *cell, context); \
+    goto *labels[(++cell)->code];
+
+  goto *labels[cell->code];
+
+  PLC_THREADED_HANDLER(read)
+  PLC_THREADED_HANDLER(write)
+  PLC_THREADED_HANDLER(trigger)
+  PLC_THREADED_HANDLER(operationAnd)
+  PLC_THREADED_HANDLER(operationOr)
+  PLC_THREADED_HANDLER(operationNot)
+  PLC_THREADED_HANDLER(operationAndNot)
+  PLC_THREADED_HANDLER(operationOrNot)
+  PLC_THREADED_HANDLER(operationDup)
+
+#undef PLC_THREADED_HANDLER
+
+end:
+#else
+  for (; cell->handler; cell++)
+    stack = cell->handler(stack, *cell, context);
+#endif
+
+  return program.program_.hasResult_ && (stack & 1);
+}
+
+#endif // !_INCLUDE_PLC_THREADED_H_
@@ -0,0 +1,183 @@
+#ifndef _INCLUDE_PLC_TRUTH_TABLE_H_
+#define _INCLUDE_PLC_TRUTH_TABLE_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "PlcSimulator.h"
+
+namespace plc
+{
+  /// <summary>
+  /// Bit sliced evaluation of an expression instruction stream: each value on
+  /// the stack is a 64 bit word, every bit (lane) is an independent input
+  /// combination. One pass over the instructions evaluates 64 rows of the truth table.
+  /// Every distinct read operand becomes a variable of the table, variable k is
+  /// bit k of the row number.
+  /// </summary>
+  class TruthTable
+  {
+  public:
+
+    static constexpr const unsigned LANES = 64;
+    static constexpr const unsigned LANE_BITS = 6;
+    static constexpr const unsigned MAX_VARIABLES = 32;
+
+    TruthTable(const std::vector<Operation>& instructions)
+    {
+      unsigned depth = 0;
+      for (const Operation& operation : instructions)
+      {
+        Step step{ operation.instruction, 0 };
+        switch (operation.instruction)
+        {
+        case Instruction::ReadInput:
+        case Instruction::ReadOutput:
+        case Instruction::ReadFlag:
+        case Instruction::ReadMonoflop:
+          step.variable = variable(operation);
+          depth++;
+          break;
+        case Instruction::OperationAnd:
+        case Instruction::OperationOr:
+        case Instruction::OperationAndNot:
+        case Instruction::OperationOrNot:
+          if (depth < 2)
+            throw PlcException("stack underflow at instruction %d", unsigned(steps_.size()));
+          depth--;
+          break;
+        case Instruction::OperationNot:
+          if (depth < 1)
+            throw PlcException("stack underflow at instruction %d", unsigned(steps_.size()));
+          break;
+        case Instruction::OperationDup:
+          if (depth < 1)
+            throw PlcException("stack underflow at instruction %d", unsigned(steps_.size()));
+          depth++;
+          break;
+        default:
+          throw PlcException("instruction %d not allowed in a truth table expression", int(operation.instruction));
+        }
+
+        if (depth > maxStackDepth_)
+          maxStackDepth_ = depth;
+
+        steps_.emplace_back(step);
+      }
+
+      if (depth != 1)
+        throw PlcException("expression leaves %d values on the stack", depth);
+      if (variables_.size() > MAX_VARIABLES)
+        throw PlcException("%d variables exceed the truth table maximum of %d", unsigned(variables_.size()), MAX_VARIABLES);
+
+      stack_.resize(maxStackDepth_);
+    }
+
+    /// <summary>
+    /// The read operands, index is the variable (column) number
+    /// </summary>
+    const std::vector<Operation>& variables() const
+    {
+      return variables_;
+    }
+
+    uint64_t rows() const
+    {
+      return uint64_t(1) << variables_.size();
+    }
+
+    /// <summary>
+    /// Evaluates one block of 64 rows, starting at row block * 64.
+    /// Lanes beyond rows() repeat the first rows.
+    /// </summary>
+    uint64_t evaluate(uint64_t block)
+    {
+      uint64_t *top = stack_.data();
+      for (const Step& step : steps_)
+      {
+        switch (step.instruction)
+        {
+        case Instruction::OperationAnd:
+          --top;
+          top[-1] &= *top;
+          break;
+        case Instruction::OperationOr:
+          --top;
+          top[-1] |= *top;
+          break;
+        case Instruction::OperationNot:
+          top[-1] = ~top[-1];
+          break;
+        case Instruction::OperationAndNot:
+          --top;
+          top[-1] &= ~*top;
+          break;
+        case Instruction::OperationOrNot:
+          --top;
+          top[-1] |= ~*top;
+          break;
+        case Instruction::OperationDup:
+          *top = top[-1];
+          ++top;
+          break;
+        default:
+          *top++ = lane(step.variable, block);
+        }
+      }
+
+      return stack_[0];
+    }
+
+    /// <summary>
+    /// Calls callback(firstRow, result, lanes) for every block of the table,
+    /// only the lowest lanes bits of result are valid.
+    /// </summary>
+    template<typename Callback>
+    void enumerate(Callback callback)
+    {
+      uint64_t blocks = (rows() + LANES - 1) / LANES;
+      unsigned lanes = rows() < LANES ? unsigned(rows()) : LANES;
+      for (uint64_t block = 0; block < blocks; block++)
+        callback(block * LANES, evaluate(block), lanes);
+    }
+
+  private:
+
+    struct Step
+    {
+      Instruction instruction;
+      unsigned variable;
+    };
+
+    unsigned variable(const Operation& operation)
+    {
+      for (unsigned i = 0; i < variables_.size(); i++)
+        if (variables_[i].instruction == operation.instruction && variables_[i].argument == operation.argument)
+          return i;
+
+      variables_.emplace_back(operation);
+
+      return unsigned(variables_.size() - 1);
+    }
+
+    static uint64_t lane(unsigned variable, uint64_t block)
+    {
+      // the lowest variables alternate within the word, the others are constant per block
+      static const uint64_t pattern[LANE_BITS] = {
+        0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+        0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull };
+
+      if (variable < LANE_BITS)
+        return pattern[variable];
+
+      return ((block >> (variable - LANE_BITS)) & 1) ? ~uint64_t(0) : 0;
+    }
+
+    std::vector<Step> steps_;
+    std::vector<Operation> variables_;
+    std::vector<uint64_t> stack_;
+    unsigned maxStackDepth_ = 0;
+  };
+}
+
+#endif // !_INCLUDE_PLC_TRUTH_TABLE_H_
@@ -9,6 +9,8 @@ namespace plc
   class Expression;
 }
 
+class PlcAst;
+
 class Variable
 {
 public:
@@ -17,6 +19,12 @@ public:
     Input, Output, Monoflop, Flag
   };
 
+  // the index of a flag or monoflop declared without one, until PlcAst::allocateIndices()
+  static constexpr const unsigned AUTO_INDEX = ~0u;
+
+  // the id of a variable not added to a PlcAst
+  static constexpr const unsigned NO_ID = ~0u;
+
   Variable(const std::string& name, Type type, unsigned index) : name_(name), type_(type), index_(index) 
   {
   }
@@ -32,6 +40,8 @@ public:
     type_ = other.type_;
     index_ = other.index_;
     time_ = other.time_;
+    allocated_ = other.allocated_;
+    id_ = other.id_;
   }
 
   void swap(Variable&& other)
@@ -40,6 +50,8 @@ public:
     type_ = other.type_;
     std::swap(index_, other.index_); 
     std::swap(time_, other.time_);
+    std::swap(allocated_, other.allocated_);
+    std::swap(id_, other.id_);
   }
 
   const std::string& name() const
@@ -57,29 +69,64 @@ public:
     return index_;
   }
 
+  /// <summary>
+  /// Sets the index allocated by PlcAst::allocateIndices()
+  /// </summary>
+  void allocate(unsigned index)
+  {
+    index_ = index;
+    allocated_ = true;
+  }
+
+  bool allocated() const
+  {
+    return allocated_;
+  }
+
+  /// <summary>
+  /// The dense id given by PlcAst::addVariable(), the variables of a PlcAst are numbered from 0
+  /// in declaration order. It indexes flat vectors instead of maps by name.
+  /// </summary>
+  unsigned id() const
+  {
+    return id_;
+  }
+
   unsigned time() const
   {
     return time_;
   }
 
-  const std::unique_ptr<plc::Expression>& expression() const
+  const plc::Expression *expression() const
   {
     return expression_;
   }
 
-  std::unique_ptr<plc::Expression>& expression()
+  plc::Expression *expression()
   {
     return expression_;
   }
 
+  /// <summary>
+  /// Sets the equation, it is kept by the ExpressionArena of the PlcAst
+  /// </summary>
+  void setExpression(plc::Expression *expression)
+  {
+    expression_ = expression;
+  }
+
 private:
 
-  std::unique_ptr<plc::Expression> expression_;
+  friend class PlcAst;
+
+  plc::Expression *expression_ = nullptr;
 
   std::string name_;
   Type type_;
   unsigned index_;
   unsigned time_= 0;
+  bool allocated_ = false;
+  unsigned id_ = NO_ID;
 };
 
 #endif // !_INCLUDE_VARIABLE_H_
@@ -6,9 +6,12 @@
 
 void plcParse(std::istream& in, PlcAst& plcAst);
 void plcParse(const char *text, PlcAst& plcAst);
+// the file is memory mapped, the fastest way to parse a large file
+void plcParseFile(const std::string& filename, PlcAst& plcAst);
 
 void convert2svg(const PlcAst& plcAst, const plc::Expression& expression, const std::string& name, std::ostream& out, const std::initializer_list<SVGOption> options);
 void convert2svg(const PlcAst& plcAst, std::ostream& out, const std::initializer_list<SVGOption> options);
+void convert2svg(const PlcAst& plcAst, std::ostream& out, const std::vector<SVGOption>& options);
 
 void translate2Avr(const PlcAst& plcAst, std::vector<uint8_t>& avrplc);
 
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <chrono>
 
 #include <boost/program_options.hpp>
 
@@ -9,6 +10,14 @@
 #include "plc2svg.h"
 #include "PlcCompiler.h"
 #include "plc.h"
+#include "PlcTruthTable.h"
+#include "PlcScanSimulator.h"
+#include "PlcOptimizer.h"
+#include "PlcJit.h"
+#include "PlcThreaded.h"
+#include "AvrEmulator.h"
+#include "AvrDisassembler.h"
+#include "PlcBatch.h"
 
 namespace po = boost::program_options;
 
@@ -45,7 +54,64 @@ namespace po = boost::program_options;
 #define BOX_TEXT_NAME     "box-text"
 #define BOX_TEXT          BOX_TEXT_NAME ",T"
 
-#define USAGE             "Usage: plc [options] plc-file\n  plc -L plcfile\n  plc -E test -O out.svg plcfile\n"
+#define TRUTH_TABLE_NAME  "truth-table"
+#define TRUTH_TABLE       TRUTH_TABLE_NAME
+
+#define REPLAY_NAME       "replay"
+#define REPLAY            REPLAY_NAME
+
+#define AVR_NAME          "avr"
+#define AVR               AVR_NAME
+
+#define CSE_NAME          "cse"
+#define CSE               CSE_NAME
+
+#define MINIMIZE_NAME     "minimize"
+#define MINIMIZE          MINIMIZE_NAME
+
+#define STACK_NAME        "stack"
+#define STACK             STACK_NAME
+
+#define PEEPHOLE_NAME     "peephole"
+#define PEEPHOLE          PEEPHOLE_NAME
+
+#define FUSED_NAME        "fused"
+#define FUSED             FUSED_NAME
+
+#define FOLD_NAME         "fold"
+#define FOLD              FOLD_NAME
+
+#define CONST_NAME        "const"
+#define CONST             CONST_NAME
+
+#define REMAP_FLAGS_NAME  "remap-flags"
+#define REMAP_FLAGS       REMAP_FLAGS_NAME
+
+#define AVR_VERSION_NAME  "avr-version"
+#define AVR_VERSION       AVR_VERSION_NAME
+
+#define MAP_NAME          "map"
+#define MAP               MAP_NAME
+
+#define CLOCK_NAME        "clock"
+#define CLOCK             CLOCK_NAME
+
+#define DISASSEMBLE_NAME  "disassemble"
+#define DISASSEMBLE       DISASSEMBLE_NAME
+
+#define DIFF_NAME         "diff"
+#define DIFF              DIFF_NAME
+
+#define BENCHMARK_NAME    "benchmark"
+#define BENCHMARK         BENCHMARK_NAME
+
+#define BATCH_NAME        "batch"
+#define BATCH             BATCH_NAME
+
+#define JOBS_NAME         "jobs"
+#define JOBS              JOBS_NAME ",j"
+
+#define USAGE             "Usage: plc [options] plc-file\n  plc -L plcfile\n  plc -E test -O out.svg plcfile\n  plc --truth-table test plcfile\n  plc --replay events.txt plcfile\n  plc --avr --minimize --cse -O out.bin plcfile\n  plc --avr --const in1=0 --const in2=1 -O out.bin plcfile\n  plc --disassemble out.bin plcfile\n  plc --disassemble new.bin --diff old.bin plcfile\n  plc --benchmark 1000000 plcfile\n  plc --batch 'programs/*.plc' --cse -O out\n  plc --batch @programs.txt --avr -j 8\n"
 
 class OptionsException : public std::exception
 {
@@ -62,14 +128,56 @@ private:
   const char *msg;
 };
 
-int list(const std::string& inputfile, bool onlyOutputs)
+std::ostream& outputStream(const po::variables_map& vm, std::ofstream& file)
 {
-  std::ifstream in(inputfile);
+  if (!vm.count(OUTPUT_FILE_NAME))
+    return std::cout;
 
+  file.open(vm[OUTPUT_FILE_NAME].as<std::string>());
+
+  return file;
+}
+
+std::vector<SVGOption> svgOptions(const po::variables_map& vm)
+{
+  std::vector<SVGOption> options;
+  if (vm.count(NO_JS_NAME))
+    options.emplace_back(SVGOption::NoJavascript);
+  else if (!vm.count(INTERACTIVE_NAME))
+    options.emplace_back(SVGOption::NotInteractive);
+  if (vm.count(LINK_LABELS_NAME))
+    options.emplace_back(SVGOption::LinkLabels);
+  if (vm.count(BOX_TEXT_NAME))
+    options.emplace_back(SVGOption::BoxText);
+
+  return options;
+}
+
+std::vector<plc::CompileOption> compileOptions(const po::variables_map& vm, bool constants)
+{
+  std::vector<plc::CompileOption> options;
+  if (vm.count(FOLD_NAME) || constants)
+    options.emplace_back(plc::CompileOption::ConstantFolding);
+  if (vm.count(CSE_NAME))
+    options.emplace_back(plc::CompileOption::CommonSubexpressions);
+  if (vm.count(MINIMIZE_NAME))
+    options.emplace_back(plc::CompileOption::Minimize);
+  if (vm.count(PEEPHOLE_NAME))
+    options.emplace_back(plc::CompileOption::Peephole);
+  if (vm.count(FUSED_NAME))
+    options.emplace_back(plc::CompileOption::FusedOperations);
+  if (vm.count(REMAP_FLAGS_NAME))
+    options.emplace_back(plc::CompileOption::RemapFlags);
+
+  return options;
+}
+
+int list(const std::string& inputfile, bool onlyOutputs)
+{
   PlcAst plcAst;
   try
   {
-    plcParse(in, plcAst);
+    plcParseFile(inputfile, plcAst);
 
     for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
       if (!onlyOutputs ||
@@ -77,6 +185,16 @@ int list(const std::string& inputfile, bool onlyOutputs)
       {
         std::cout << it->first << std::endl;
       }
+
+    std::vector<std::vector<std::string>> cycles;
+    plcAst.equationOrder(&cycles);
+    for (const std::vector<std::string>& cycle : cycles)
+    {
+      std::cerr << "Warning: feedback cycle";
+      for (const std::string& name : cycle)
+        std::cerr << ' ' << name;
+      std::cerr << std::endl;
+    }
   }
   catch (std::exception& ex)
   {
@@ -95,9 +213,7 @@ int equation(const po::variables_map& vm)
   PlcAst plcAst;
   try
   {
-    std::ifstream in(vm[INPUT_FILE_NAME].as<std::string>());
-
-    plcParse(in, plcAst);
+    plcParseFile(vm[INPUT_FILE_NAME].as<std::string>(), plcAst);
   }
   catch (std::exception& ex)
   {
@@ -108,22 +224,12 @@ int equation(const po::variables_map& vm)
 
   std::ofstream out(vm[OUTPUT_FILE_NAME].as<std::string>());
 
-  std::vector<SVGOption> options;
-  if (vm.count(NO_JS_NAME))
-    options.emplace_back(SVGOption::NoJavascript);
-  else if (!vm.count(INTERACTIVE_NAME))
-    options.emplace_back(SVGOption::NotInteractive);
-  if (vm.count(LINK_LABELS_NAME))
-    options.emplace_back(SVGOption::LinkLabels);
-  if (vm.count(BOX_TEXT_NAME))
-    options.emplace_back(SVGOption::BoxText);
-
-  Plc2svg plc2svg(plcAst, out, options);
+  Plc2svg plc2svg(plcAst, out, svgOptions(vm));
   if (vm.count(ALL_NAME))
   {
     std::vector<std::string> names;
     for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
-      if (plcAst.getVariable(it->first).type() == Variable::Type::Output && it->second.expression().operator bool())
+      if (plcAst.getVariable(it->first).type() == Variable::Type::Output && it->second.expression())
         names.emplace_back(it->first);
 
     plc2svg.convertMultiple(names);
@@ -132,7 +238,7 @@ int equation(const po::variables_map& vm)
   {
     const std::string& equationName = vm[EQUATION_NAME].as<std::string>();
     const Variable& variable(plcAst.getVariable(equationName));
-    if (!variable.expression().operator bool())
+    if (!variable.expression())
     {
       std::cout << "Error: Equation " << equationName << " does not exists.";
 
@@ -150,12 +256,440 @@ int equation(const po::variables_map& vm)
   return  0;
 }
 
+int truthTable(const po::variables_map& vm)
+{
+  PlcAst plcAst;
+  try
+  {
+    plcParseFile(vm[INPUT_FILE_NAME].as<std::string>(), plcAst);
+
+    const std::string& equationName = vm[TRUTH_TABLE_NAME].as<std::string>();
+
+    std::vector<plc::Operation> instructions;
+    plc::compile(plcAst, plcAst.resolveDependencies(equationName), [&instructions](plc::Instruction instruction, unsigned argument)
+    {
+      instructions.emplace_back(plc::Operation{ instruction, argument });
+    });
+
+    plc::TruthTable truthTable(instructions);
+
+    std::vector<std::string> names;
+    for (const plc::Operation& operation : truthTable.variables())
+      for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
+        if (plc::readInstruction(it->second.type()) == operation.instruction && it->second.index() == operation.argument)
+          names.emplace_back(it->first);
+
+    std::ofstream file;
+    std::ostream& out = outputStream(vm, file);
+
+    for (auto it = names.rbegin(); it != names.rend(); it++)
+      out << *it << ' ';
+    out << "= " << equationName << '\n';
+
+    std::string row(2 * names.size() + 3, ' ');
+    row[row.size() - 2] = '=';
+    truthTable.enumerate([&out, &row, &names](uint64_t firstRow, uint64_t result, unsigned lanes)
+    {
+      for (unsigned lane = 0; lane < lanes; lane++)
+      {
+        uint64_t bits = firstRow + lane;
+        for (unsigned i = 0; i < names.size(); i++)
+          row[2 * (names.size() - 1 - i)] = ((bits >> i) & 1) ? '1' : '0';
+
+        out << row << (((result >> lane) & 1) ? '1' : '0') << '\n';
+      }
+    });
+  }
+  catch (std::exception& ex)
+  {
+    std::cout << "Error: " << ex.what() << std::endl;
+
+    return 1;
+  }
+
+  return 0;
+}
+
+int replay(const po::variables_map& vm)
+{
+  PlcAst plcAst;
+  try
+  {
+    plcParseFile(vm[INPUT_FILE_NAME].as<std::string>(), plcAst);
+
+    std::ifstream eventsIn(vm[REPLAY_NAME].as<std::string>());
+    if (!eventsIn)
+      throw PlcException("can not open '%s'", vm[REPLAY_NAME].as<std::string>().c_str());
+
+    std::vector<plc::InputEvent> events(plc::readInputEvents(eventsIn, plcAst));
+
+    std::vector<std::string> outputNames(1 + plcAst.maxVariableIndexOfType(Variable::Type::Output));
+    for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
+      if (it->second.type() == Variable::Type::Output)
+        outputNames[it->second.index()] = it->first;
+
+    std::ofstream file;
+    std::ostream& out = outputStream(vm, file);
+
+    PlcScanSimulator scanSimulator(plcAst);
+
+    std::vector<bool> outputs(outputNames.size());
+    PlcScanSimulator::Observer observer = [&out, &outputs, &outputNames](uint64_t ms, const PlcSimulator& simulator)
+    {
+      for (unsigned i = 0; i < outputs.size(); i++)
+      {
+        bool value = simulator.get(PlcSimulator::IOType::Output, i);
+        if (value != outputs[i] && !outputNames[i].empty())
+          out << ms / 1000.0 << "s " << outputNames[i] << ' ' << (value ? 1 : 0) << '\n';
+
+        outputs[i] = value;
+      }
+    };
+
+    scanSimulator.replay(events, observer);
+
+    // let the monoflops triggered by the last events elapse
+    unsigned longest = 0;
+    for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
+      if (it->second.type() == Variable::Type::Monoflop && it->second.time() > longest)
+        longest = it->second.time();
+
+    scanSimulator.advance(uint64_t(longest) * plc::TICK_MS, observer);
+
+    out << "simulated " << scanSimulator.now() / 1000.0 << "s, " << events.size() << " input events, "
+      << scanSimulator.scans() << " scans" << std::endl;
+  }
+  catch (std::exception& ex)
+  {
+    std::cout << "Error: " << ex.what() << std::endl;
+
+    return 1;
+  }
+
+  return 0;
+}
+
+/// <summary>
+/// Prints the index of each flag and monoflop, allocated or declared, with its number of uses,
+/// and the index in the code, if the flags were remapped.
+/// </summary>
+void printMapping(const PlcAst& plcAst, const plc::CompileStatistics& statistics)
+{
+  std::vector<unsigned> uses(plcAst.variableUses());
+  std::vector<unsigned> mapped(statistics.flagMapping.size(), 0);
+  for (Variable::Type type : { Variable::Type::Flag, Variable::Type::Monoflop })
+  {
+    std::vector<const Variable*> variables;
+    for (auto it = plcAst.variableDescription().begin(); it != plcAst.variableDescription().end(); it++)
+      if (it->second.type() == type)
+        variables.emplace_back(&it->second);
+
+    std::sort(variables.begin(), variables.end(), [](const Variable *a, const Variable *b) { return a->index() < b->index(); });
+    for (const Variable *variable : variables)
+    {
+      std::cout << (type == Variable::Type::Flag ? "flag " : "monoflop ") << variable->name() << " = " << variable->index()
+        << (variable->allocated() ? " allocated, " : " declared, ") << uses[variable->id()] << " uses";
+      if (type == Variable::Type::Flag && variable->index() < statistics.flagMapping.size())
+      {
+        unsigned index = statistics.flagMapping[variable->index()];
+        mapped[variable->index()] = 1;
+        if (index == ~0u)
+          std::cout << ", unused";
+        else
+          std::cout << ", code " << index;
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  // flags of the PlcOptimizer
+  for (unsigned index = 0; index < statistics.flagMapping.size(); index++)
+    if (!mapped[index] && statistics.flagMapping[index] != ~0u)
+      std::cout << "flag " << index << ", code " << statistics.flagMapping[index] << std::endl;
+}
+
+int avr(const po::variables_map& vm)
+{
+  if (!vm.count(OUTPUT_FILE_NAME))
+    throw OptionsException("missing output file name");
+
+  PlcAst plcAst;
+  try
+  {
+    plcParseFile(vm[INPUT_FILE_NAME].as<std::string>(), plcAst);
+
+    if (vm.count(CONST_NAME))
+      for (const std::string& constant : vm[CONST_NAME].as<std::vector<std::string>>())
+      {
+        size_t pos = constant.find('=');
+        if (pos == std::string::npos || (constant.substr(pos + 1) != "0" && constant.substr(pos + 1) != "1"))
+          throw PlcException("constant '%s' is not name=0|1", constant.c_str());
+
+        plcAst.setConstant(constant.substr(0, pos), constant.substr(pos + 1) == "1");
+      }
+
+    std::vector<plc::CompileOption> options(compileOptions(vm, !plcAst.constants().empty()));
+
+    unsigned avrVersion = vm[AVR_VERSION_NAME].as<unsigned>();
+    plc::PlcOptimizer optimizer(plcAst, options, avrVersion);
+    std::vector<plc::Operation> instructions;
+    optimizer.compile(instructions);
+
+    std::vector<uint8_t> avrplc;
+    plc::translateAvr(instructions, avrplc, avrVersion);
+
+    std::ofstream out(vm[OUTPUT_FILE_NAME].as<std::string>(), std::ios::binary);
+    out.write(reinterpret_cast<const char*>(avrplc.data()), avrplc.size());
+    if (!out)
+      throw PlcException("can not write '%s'", vm[OUTPUT_FILE_NAME].as<std::string>().c_str());
+
+    const plc::CompileStatistics& statistics = optimizer.statistics();
+    std::cout << statistics.instructions << " instructions, " << statistics.bytes << " bytes" << std::endl;
+    if (!options.empty())
+      std::cout << "saved " << statistics.instructionsSaved() << " instructions, " << statistics.bytesSaved() << " bytes, "
+        << statistics.foldedEquations << " folded equations, " << statistics.constantEquations << " constant equations, "
+        << statistics.minimizedEquations << " minimized equations, " << statistics.peepholeRewrites << " peephole rewrites, "
+        << statistics.sharedExpressions << " shared expressions in " << statistics.flags << " flags from " << statistics.firstFlag << std::endl;
+    if (!statistics.flagMapping.empty())
+      std::cout << "remapped " << std::count_if(statistics.flagMapping.begin(), statistics.flagMapping.end(), [](unsigned index) { return index != ~0u; })
+        << " flags, saved " << statistics.remapSaved << " bytes" << std::endl;
+    std::cout << "max stack depth " << statistics.maxStackDepth << std::endl;
+
+    if (vm.count(MAP_NAME))
+      printMapping(plcAst, statistics);
+
+    AvrEmulator emulator(avrplc, std::max(statistics.maxStackDepth, 1u));
+    AvrScanStatistics scan(emulator.worstCase());
+    unsigned clock = vm[CLOCK_NAME].as<unsigned>();
+    std::cout << "scan: " << scan.instructions << " instructions, " << scan.extended << " extended arguments, "
+      << scan.cycles << " cycles, " << scan.microseconds(clock) << " us at " << clock / 1e6 << " MHz" << std::endl;
+
+    if (vm.count(STACK_NAME))
+    {
+      plc::VariableNames names(plcAst);
+      for (const std::pair<plc::Operation, unsigned>& equation : statistics.stackDepths)
+        std::cout << "  " << names(equation.first) << ": " << equation.second << std::endl;
+    }
+  }
+  catch (std::exception& ex)
+  {
+    std::cout << "Error: " << ex.what() << std::endl;
+
+    return 1;
+  }
+
+  return 0;
+}
+
+/// <summary>
+/// Runs scans with a pseudo random input changing before each scan, a program
+/// without inputs runs with none changing. Returns the time per scan in nanoseconds.
+/// </summary>
+template<typename Program>
+double measure(PlcSimulator& simulator, const Program& program, uint64_t scans)
+{
+  simulator.resetAll();
+
+  unsigned inputs = simulator.size(PlcSimulator::IOType::Input);
+  uint32_t random = 1;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t scan = 0; scan < scans; scan++)
+  {
+    random = random * 1103515245 + 12345;
+    if (inputs)
+      simulator.set(PlcSimulator::IOType::Input, (random >> 16) % inputs, ((random >> 8) & 1) != 0);
+    simulator.execute<PlcScanSimulator::STACKSIZE>(program);
+  }
+  std::chrono::duration<double, std::nano> elapsed(std::chrono::steady_clock::now() - start);
+
+  return elapsed.count() / double(scans ? scans : 1);
+}
+
+/// <summary>
+/// Parses the file repeatedly for at least half a second, returns MB/s. The stream variant
+/// opens an ifstream for each parse, the other one maps the file.
+/// </summary>
+double parseThroughput(const std::string& filename, bool stream)
+{
+  uint64_t size = MappedFile(filename).size();
+  uint64_t bytes = 0;
+  std::chrono::duration<double> elapsed(0);
+  auto start = std::chrono::steady_clock::now();
+  do
+  {
+    PlcAst plcAst;
+    if (stream)
+    {
+      std::ifstream in(filename);
+      plcParse(in, plcAst);
+    }
+    else
+      plcParseFile(filename, plcAst);
+
+    bytes += size;
+    elapsed = std::chrono::steady_clock::now() - start;
+  } while (elapsed.count() < 0.5);
+
+  return double(bytes) / 1e6 / elapsed.count();
+}
+
+std::vector<uint8_t> readImage(const std::string& filename)
+{
+  std::ifstream in(filename, std::ios::binary);
+  if (!in)
+    throw PlcException("can not open '%s'", filename.c_str());
+
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+/// <summary>
+/// Lists an AVR image with the variable names of the plc file and the size of each equation.
+/// With --diff only the equations of different size are printed, the result is 2, if the image grew.
+/// </summary>
+int disassemble(const po::variables_map& vm)
+{
+  PlcAst plcAst;
+  try
+  {
+    plcParseFile(vm[INPUT_FILE_NAME].as<std::string>(), plcAst);
+
+    plc::VariableNames names(plcAst);
+    std::vector<uint8_t> image(readImage(vm[DISASSEMBLE_NAME].as<std::string>()));
+    std::vector<plc::EquationSize> sizes(plc::equationSizes(image));
+
+    if (!vm.count(DIFF_NAME))
+    {
+      plc::disassembleAvr(image, names, std::cout);
+
+      unsigned instructions = 0;
+      for (const plc::EquationSize& equation : sizes)
+      {
+        std::cout << names(equation.write) << ": " << equation.instructions << " instructions, " << equation.bytes << " bytes" << std::endl;
+        instructions += equation.instructions;
+      }
+      std::cout << sizes.size() << " equations, " << instructions << " instructions, " << image.size() << " bytes" << std::endl;
+
+      return 0;
+    }
+
+    std::vector<uint8_t> before(readImage(vm[DIFF_NAME].as<std::string>()));
+    for (const plc::SizeDifference& difference : plc::compareSizes(plc::equationSizes(before), sizes, names))
+      std::cout << difference.name << ": " << difference.bytesBefore << " -> " << difference.bytesAfter << " bytes ("
+        << std::showpos << int(difference.bytesAfter) - int(difference.bytesBefore) << std::noshowpos << ')' << std::endl;
+
+    std::cout << "total: " << before.size() << " -> " << image.size() << " bytes" << std::endl;
+    if (image.size() > before.size())
+      return 2;
+  }
+  catch (std::exception& ex)
+  {
+    std::cout << "Error: " << ex.what() << std::endl;
+
+    return 1;
+  }
+
+  return 0;
+}
+
+int benchmark(const po::variables_map& vm)
+{
+  PlcAst plcAst;
+  try
+  {
+    plcParseFile(vm[INPUT_FILE_NAME].as<std::string>(), plcAst);
+
+    uint64_t scans = vm[BENCHMARK_NAME].as<uint64_t>();
+
+    std::vector<plc::Operation> instructions;
+    plc::compile(plcAst, instructions);
+
+    PlcSimulator simulator(plc::createSimulator(plcAst));
+    PlcProgram program(simulator.load(instructions));
+    PlcJitProgram jitProgram(simulator.load(instructions));
+    PlcThreadedProgram threadedProgram(simulator.load(instructions));
+
+    std::cout << scans << " scans, " << instructions.size() << " instructions" << std::endl;
+
+    double interpreted = measure(simulator, program, scans);
+    std::vector<uint64_t> image(simulator.image());
+    std::cout << "interpreter: " << interpreted << " ns/scan" << std::endl;
+
+    double threaded = measure(simulator, threadedProgram, scans);
+    std::cout << "threaded:    " << threaded << " ns/scan, " << interpreted / threaded << "x" << std::endl;
+    bool identical = image == simulator.image();
+
+    double jit = measure(simulator, jitProgram, scans);
+    if (jitProgram.native())
+      std::cout << "jit:         " << jit << " ns/scan, " << interpreted / jit << "x, " << jitProgram.codeSize() << " bytes of code" << std::endl;
+    else
+      std::cout << "jit:         not available on this platform" << std::endl;
+
+    if (!identical || image != simulator.image())
+      throw PlcException("the backends computed different process images");
+
+    std::cout << "parser:      " << parseThroughput(vm[INPUT_FILE_NAME].as<std::string>(), false) << " MB/s mapped, "
+      << parseThroughput(vm[INPUT_FILE_NAME].as<std::string>(), true) << " MB/s from a stream" << std::endl;
+  }
+  catch (std::exception& ex)
+  {
+    std::cout << "Error: " << ex.what() << std::endl;
+
+    return 1;
+  }
+
+  return 0;
+}
+
+/// <summary>
+/// Compiles and renders many programs on all cores, in one process: AVR images and SVGs, or only
+/// one of them with --avr or -A. Prints the errors and one summary, the result is 1, if a program failed.
+/// </summary>
+int batch(const po::variables_map& vm)
+{
+  if (vm.count(CONST_NAME))
+    throw OptionsException("--" CONST_NAME " is not accepted with --" BATCH_NAME ", use --" FOLD_NAME);
+
+  plc::BatchOptions options;
+  options.avr = vm.count(AVR_NAME) || !vm.count(ALL_NAME);
+  options.svg = vm.count(ALL_NAME) || !vm.count(AVR_NAME);
+  options.compileOptions = compileOptions(vm, false);
+  options.avrVersion = vm[AVR_VERSION_NAME].as<unsigned>();
+  options.svgOptions = svgOptions(vm);
+  if (vm.count(OUTPUT_FILE_NAME))
+    options.outputDirectory = vm[OUTPUT_FILE_NAME].as<std::string>();
+  options.threads = vm[JOBS_NAME].as<unsigned>();
+
+  plc::BatchSummary summary;
+  try
+  {
+    std::vector<std::string> programs(plc::expandPrograms(vm[BATCH_NAME].as<std::vector<std::string>>()));
+
+    for (const plc::BatchResult& result : plc::runBatch(programs, options, &summary))
+      if (!result.error.empty())
+        std::cout << "Error: " << result.program << ": " << result.error << std::endl;
+  }
+  catch (std::exception& ex)
+  {
+    std::cout << "Error: " << ex.what() << std::endl;
+
+    return 1;
+  }
+
+  std::cout << summary.programs << " programs, " << summary.failed << " failed, " << summary.instructions << " instructions, "
+    << summary.bytes << " bytes, " << summary.svgBytes << " bytes of SVG" << std::endl;
+  std::cout << summary.seconds << " s on " << summary.threads << " threads, "
+    << (summary.seconds > 0 ? summary.cpuSeconds / summary.seconds : 0) << "x, " << summary.steals << " stolen" << std::endl;
+
+  return summary.failed ? 1 : 0;
+}
+
 int main(int argc, char *argv[])
 {
   po::options_description desc("Options");
   desc.add_options()
     ( "help,?", "Show Help")
-    ( INPUT_FILE, po::value<std::string>()->required(), "plc file")
+    ( INPUT_FILE, po::value<std::string>(), "plc file")
     ( OUTPUT_FILE, po::value<std::string>(), "output file")
     ( EQUATION, po::value<std::string>(), "convert a single Equation")
     ( ALL, "convert all Equations")
@@ -166,6 +700,25 @@ int main(int argc, char *argv[])
     ( BOX_TEXT, "addition text field in each box")
     ( LINK_LABELS, "Label link wires")
     ( RESOLVE_DEP, "resolve Dependencies in SVG generation")
+    ( TRUTH_TABLE, po::value<std::string>(), "print the truth table of an Equation")
+    ( REPLAY, po::value<std::string>(), "simulate scan cycles for timed input changes: ms input 0|1")
+    ( AVR, "compile to AVR byte code")
+    ( CSE, "eliminate common sub expressions")
+    ( MINIMIZE, "minimize each equation")
+    ( STACK, "print the stack depth of each equation")
+    ( PEEPHOLE, "remove redundant instruction sequences")
+    ( FUSED, "use the fused operations And Not, Or Not and Dup, includes --" PEEPHOLE_NAME)
+    ( FOLD, "fold the constant inputs of the plc file into the equations")
+    ( CONST, po::value<std::vector<std::string>>(), "declare an input constant: name=0|1, includes --" FOLD_NAME)
+    ( REMAP_FLAGS, "renumber the flags, the most used ones get the 1 byte indices")
+    ( AVR_VERSION, po::value<unsigned>()->default_value(avrplc::VERSION), "AVR byte code version, 2 allows arguments up to 65535")
+    ( MAP, "print the index of each flag and monoflop with its uses")
+    ( CLOCK, po::value<unsigned>()->default_value(16000000), "AVR clock in Hz for the scan time of --" AVR_NAME)
+    ( DISASSEMBLE, po::value<std::string>(), "list an AVR image with the names of the plc file and the size of each equation")
+    ( DIFF, po::value<std::string>(), "compare the equation sizes of the --" DISASSEMBLE_NAME " image with an older image")
+    ( BENCHMARK, po::value<uint64_t>(), "run scans with the interpreter, the threaded interpreter and the native backend")
+    ( BATCH, po::value<std::vector<std::string>>()->multitoken(), "compile and render many programs in parallel: files, patterns like dir/*.plc or @list, -O is the output directory")
+    ( JOBS, po::value<unsigned>()->default_value(0), "threads of --" BATCH_NAME ", 0 for one per core")
     ;
 
   po::variables_map vm;
@@ -183,15 +736,36 @@ int main(int argc, char *argv[])
       return 0;
     }
 
-    if (vm.count(LIST_NAME) + vm.count(EQUATION_NAME) + vm.count(ALL_NAME) > 1)
-      throw OptionsException("Only one Option of " LIST_NAME ", " EQUATION_NAME " or " ALL_NAME " accepted.");
+    if (vm.count(BATCH_NAME))
+    {
+      if (vm.count(LIST_NAME) + vm.count(EQUATION_NAME) + vm.count(TRUTH_TABLE_NAME) + vm.count(REPLAY_NAME) + vm.count(DISASSEMBLE_NAME) + vm.count(BENCHMARK_NAME) + vm.count(INPUT_FILE_NAME))
+        throw OptionsException("--" BATCH_NAME " accepts only the options of " AVR_NAME " and " ALL_NAME ", no plc file.");
+
+      return batch(vm);
+    }
+
+    if (!vm.count(INPUT_FILE_NAME))
+      throw OptionsException("the option '--" INPUT_FILE_NAME "' is required but missing");
+
+    if (vm.count(LIST_NAME) + vm.count(EQUATION_NAME) + vm.count(ALL_NAME) + vm.count(TRUTH_TABLE_NAME) + vm.count(REPLAY_NAME) + vm.count(AVR_NAME) + vm.count(DISASSEMBLE_NAME) + vm.count(BENCHMARK_NAME) > 1)
+      throw OptionsException("Only one Option of " LIST_NAME ", " EQUATION_NAME ", " ALL_NAME ", " TRUTH_TABLE_NAME ", " REPLAY_NAME ", " AVR_NAME ", " DISASSEMBLE_NAME " or " BENCHMARK_NAME " accepted.");
 
     if (vm.count(LIST_NAME))
       return list(vm[INPUT_FILE_NAME].as<std::string>(), vm.count(OUTPUTS_NAME) > 0);
     else if (vm.count(EQUATION_NAME) || vm.count(ALL_NAME))
       return equation(vm);
+    else if (vm.count(TRUTH_TABLE_NAME))
+      return truthTable(vm);
+    else if (vm.count(REPLAY_NAME))
+      return replay(vm);
+    else if (vm.count(AVR_NAME))
+      return avr(vm);
+    else if (vm.count(DISASSEMBLE_NAME))
+      return disassemble(vm);
+    else if (vm.count(BENCHMARK_NAME))
+      return benchmark(vm);
     else
-      throw OptionsException("at least one Option of " LIST_NAME ", " EQUATION_NAME " or " ALL_NAME " necessary");
+      throw OptionsException("at least one Option of " LIST_NAME ", " EQUATION_NAME ", " ALL_NAME ", " TRUTH_TABLE_NAME ", " REPLAY_NAME ", " AVR_NAME ", " DISASSEMBLE_NAME " or " BENCHMARK_NAME " necessary");
   }
   catch (const std::exception& ex)
   {
@@ -201,33 +775,6 @@ int main(int argc, char *argv[])
     return 1;
   }
 
-    /*std::vector<plc::Operation> instructions;
-    plc::compile(plcAst, equation, "output", instructions);
-
-    PlcSimulator plcSimulator(5, 0, 0, 0);
-
-    for (unsigned bitvector = 0; bitvector < 32; bitvector++)
-    {
-      for (int i = 4; i >= 0; i--)
-      {
-        plcSimulator.io(PlcSimulator::IOType::Input, i) = bitvector & (1 << i);
-
-        std::cout << (plcSimulator.io(PlcSimulator::IOType::Input, i) ? 1 : 0) << ' ';
-      }
-
-      std::cout << " = " << (plcSimulator.execute<5>(instructions) ? 1 : 0) << std::endl;
-    }
-
-    std::vector<uint8_t> avrplc;
-    plc::translateAvr(instructions, avrplc);
-
-    std::cout.width(2);
-    std::cout.fill('0');
-    for (uint8_t op : avrplc)
-      std::cout << std::hex << unsigned(op) << ' ';
-
-    std::cout << std::endl;*/
-
   return 0;
 }
 
@@ -35,7 +35,10 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 
 # Object Files
 OBJECTFILES= \
+	${OBJECTDIR}/ParserInput.o \
+	${OBJECTDIR}/PlcBatch.o \
 	${OBJECTDIR}/PlcExpression.o \
+	${OBJECTDIR}/PlcJit.o \
 	${OBJECTDIR}/main.o \
 	${OBJECTDIR}/plc.o \
 	${OBJECTDIR}/plc2svgbase.o \
@@ -68,11 +71,26 @@ ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/libplc.a: ${OBJECTFILES}
 	${AR} -rv ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/libplc.a ${OBJECTFILES} 
 	$(RANLIB) ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/libplc.a
 
+${OBJECTDIR}/ParserInput.o: ParserInput.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I. -Iinclude -I/home/pi/beast_http_server -I/home/pi/boost_1_68_0 -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ParserInput.o ParserInput.cpp
+
+${OBJECTDIR}/PlcBatch.o: PlcBatch.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I. -Iinclude -I/home/pi/beast_http_server -I/home/pi/boost_1_68_0 -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/PlcBatch.o PlcBatch.cpp
+
 ${OBJECTDIR}/PlcExpression.o: PlcExpression.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -I. -Iinclude -I/home/pi/beast_http_server -I/home/pi/boost_1_68_0 -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/PlcExpression.o PlcExpression.cpp
 
+${OBJECTDIR}/PlcJit.o: PlcJit.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I. -Iinclude -I/home/pi/beast_http_server -I/home/pi/boost_1_68_0 -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/PlcJit.o PlcJit.cpp
+
 ${OBJECTDIR}/main.o: main.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -6,6 +6,7 @@
 #include <unordered_map>
 
 #include "plc2svgbase.h"
+#include "PlcFlatExpression.h"
 
 class Plc2svg : public Plc2svgBase
 {
@@ -22,66 +23,65 @@ public:
 
   void convertMultiple(const std::vector<std::string>& names)
   {
-    std::unordered_map<std::string, plc::Expression> resolved;
-    std::vector<const plc::Expression*> expressions;
-    std::unordered_map<std::string,unsigned> toSkip;
+    std::vector<plc::FlatExpression> resolved(names.size());
+    std::vector<const plc::FlatExpression*> expressions;
+    std::vector<unsigned> toSkip;
 
-    for (auto it = names.begin(); it != names.end(); it++)
+    for (unsigned i = 0; i < names.size(); i++)
     {
-      resolved.emplace(*it, plcAst.resolveDependencies(*it, &toSkip));
-      expressions.emplace_back(&resolved[*it]);
+      resolved[i].lower(plcAst.resolveDependencies(names[i], &toSkip));
+      resolved[i].assignIds(lastGateId);
+      expressions.emplace_back(&resolved[i]);
     }
 
-    for (auto it = toSkip.begin(); it != toSkip.end(); it++)
-      if (it->second > 1)
-        signalCrossing.emplace(it->first);
+    for (unsigned id = 0; id < toSkip.size(); id++)
+      if (toSkip[id] > 1)
+        signalCrossing.emplace(id);
 
-    for (auto it = names.begin(); it != names.end(); it++)
-      resolved[*it].countInputs(inputCountMap);
+    for (const plc::FlatExpression& flat : resolved)
+      flat.countInputs(inputCounts);
 
     setupParameter(expressions);
 
     svg::AreaSize::clear();
     unsigned y = 1;
-    for (auto it = names.begin(); it != names.end(); it++)
-      y+= 2 + convert(y, 0, resolved[*it], plc::Term::Unary::None, &plcAst.getVariable(*it));
+    for (unsigned i = 0; i < names.size(); i++)
+      y+= 2 + convert(y, 0, resolved[i], resolved[i].root(), false, &plcAst.getVariable(names[i]));
 
     writeOutput(svg::AreaSize::x(), svg::AreaSize::y());
   }
 
   void convert(const plc::Expression& expression, const std::string& name)
   {
-    expression.countInputs(inputCountMap);
+    plc::FlatExpression flat(expression);
+    flat.assignIds(lastGateId);
+    flat.countInputs(inputCounts);
 
-    std::array<const plc::Expression*, 1> a{ &expression };
+    std::array<const plc::FlatExpression*, 1> a{ &flat };
     setupParameter(a);
 
-    maxLevel = expression.countLevels();
+    maxLevel = flat.countLevels();
 
     svg::AreaSize::clear();
     const Variable& variable = plcAst.getVariable(name);
-    unsigned y= 2 + convert(1, 0, expression, plc::Term::Unary::None, &variable);
+    unsigned y= 2 + convert(1, 0, flat, flat.root(), false, &variable);
 
     writeOutput(svg::AreaSize::x(), svg::AreaSize::y());
   }
 
 private:
 
-  void countLevelCrossings(unsigned level, const plc::Expression& expression)
+  void countLevelCrossings(unsigned level, const plc::FlatExpression& flat, unsigned node)
   {
     while (crossingsPerLevel.size() <= level)
       crossingsPerLevel.emplace_back(0);
 
-    if (expression.variable())
-    {
-      auto find = inputCountMap.find(expression.variable()->name());
-      if (find != inputCountMap.end())
-        ++crossingsPerLevel[level];
-    }
+    if (flat.variable(node) != plc::FlatExpression::NO_VARIABLE && inputCount(plcAst.variable(flat.variable(node))))
+      ++crossingsPerLevel[level];
 
-    for (auto it = expression.terms().begin(); it != expression.terms().end(); it++)
-      if (it->type() == plc::Term::Type::Expression)
-        countLevelCrossings(level + 1, *it->expression());
+    for (const unsigned *child = flat.childrenBegin(node); child != flat.childrenEnd(node); child++)
+      if (flat.kind(*child) == plc::FlatExpression::Kind::Expression)
+        countLevelCrossings(level + 1, flat, *child);
   }
 
   template <typename T>
@@ -90,7 +90,7 @@ private:
     maxLevel = 0;
     for (auto it = v.begin(); it != v.end(); it++)
     {
-      countLevelCrossings(0, **it);
+      countLevelCrossings(0, **it, (*it)->root());
       unsigned tmp = (*it)->countLevels();
       if (tmp > maxLevel)
         maxLevel = tmp;
@@ -98,22 +98,23 @@ private:
 
     unsigned crossings = 0;
     unsigned chars = 0;
-    for (auto it = inputCountMap.begin(); it != inputCountMap.end(); it++)
-    {
-      unsigned width = unsigned(it->first.length());
-      if (width > chars)
-        chars = width;
+    for (unsigned id = 0; id < inputCounts.size(); id++)
+      if (inputCounts[id])
+      {
+        unsigned width = unsigned(plcAst.variable(id).name().length());
+        if (width > chars)
+          chars = width;
 
-      if (it->second > 1)
-        crossings++;
-    }
+        if (inputCounts[id] > 1)
+          crossings++;
+      }
 
     crossingsPerLevel.emplace_back(crossings);
 
     textWidth = chars * svg::CHAR_CELL_WIDTH;
   }
 
-  unsigned convert(unsigned ypos, unsigned level, const plc::Expression& expression, plc::Term::Unary unary, const Variable *variable = nullptr)
+  unsigned convert(unsigned ypos, unsigned level, const plc::FlatExpression& flat, unsigned node, bool negated, const Variable *variable = nullptr)
   {
     //std::cout << "convert Expression " << expression.signalName() << " " << expression.id() << " ypos: " << ypos << " level: " << level << std::endl;
     
@@ -122,21 +123,21 @@ private:
     unsigned width = textWidth + (maxLevel - level - 1) * (LINE_LENGTH + GATE_WIDTH) + LINE_LENGTH;
     unsigned outy = (index + ypos) * svg::CHAR_CELL_HEIGHT;
 
-    for (const plc::Term& term : expression.terms())
+    for (const unsigned *child = flat.childrenBegin(node); child != flat.childrenEnd(node); child++)
     {
       unsigned y = (index + ypos) * svg::CHAR_CELL_HEIGHT;
-      switch (term.type())
+      switch (flat.kind(*child))
       {
-      case plc::Term::Type::Identifier:
-        convertInput(term, level, y, width);
+      case plc::FlatExpression::Kind::Variable:
+        convertInput(plcAst.variable(flat.variable(*child)), flat.negated(*child), level, y, width);
 
         index++;
         size++;
         break;
 
-      case plc::Term::Type::Expression:
+      case plc::FlatExpression::Kind::Expression:
       {
-        unsigned subSize = 2 + convert(index + ypos, level + 1, *term.expression(), term.unary());
+        unsigned subSize = 2 + convert(index + ypos, level + 1, flat, *child, flat.negated(*child));
 
         index += subSize;
         size += subSize;
@@ -150,18 +151,18 @@ private:
     unsigned lineX1 = crossingWidthUpToLevel(level) + width;
     unsigned lineX2 = crossingWidthUpToLevel(level - 1) + width + GATE_WIDTH + LINE_LENGTH;
 
-    if (unary != plc::Term::Unary::None)
+    if (negated)
       lineX2 -= 2 * INVERT_RADIUS;
 
-    if (expression.op() != plc::Expression::Operator::None /*|| expression.terms().size() > 1*/)
+    if (flat.op(node) != plc::Expression::Operator::None /*|| expression.terms().size() > 1*/)
     {
       svgOut << svg::Rect(lineX1, ypos * svg::CHAR_CELL_HEIGHT, GATE_WIDTH, (size + 1) * svg::CHAR_CELL_HEIGHT, { BOX })
-        << svg::Text(lineX1 + CHAR_OFFSET, (1 + ypos) * svg::CHAR_CELL_HEIGHT + CHAR_OFFSET_Y, operatorSymbol(expression.op()), {});
+        << svg::Text(lineX1 + CHAR_OFFSET, (1 + ypos) * svg::CHAR_CELL_HEIGHT + CHAR_OFFSET_Y, operatorSymbol(flat.op(node)), {});
 
       if ( hasOption(SVGOption::BoxText))
       {
         std::ostringstream tid;
-        tid << 't' << gateCssClass(expression);
+        tid << 't' << gateCssClass(flat, node);
 
         svgOut << svg::Text(lineX1 + CHAR_OFFSET, (2 + ypos) * svg::CHAR_CELL_HEIGHT + CHAR_OFFSET_Y, "", {}, tid.str().c_str());
       }
@@ -184,18 +185,18 @@ private:
     }
     else
     {
-      svgOut << svg::Line(lineX1, outy, lineX2, outy, { LINK, gateCssClass(expression) });
-      if (unary != plc::Term::Unary::None)
-        svgOut << svg::Circle(lineX2 + INVERT_RADIUS, outy, INVERT_RADIUS, { INVERT, gateCssClass(expression) });
+      svgOut << svg::Line(lineX1, outy, lineX2, outy, { LINK, gateCssClass(flat, node) });
+      if (negated)
+        svgOut << svg::Circle(lineX2 + INVERT_RADIUS, outy, INVERT_RADIUS, { INVERT, gateCssClass(flat, node) });
 
       if(hasOption(SVGOption::LinkLabels))
-        svgOut << svg::Text(lineX2 - 3 * svg::CHAR_CELL_WIDTH, (1 + ypos) * svg::CHAR_CELL_HEIGHT + CHAR_OFFSET_Y, gateCssClass(expression), {});
+        svgOut << svg::Text(lineX2 - 3 * svg::CHAR_CELL_WIDTH, (1 + ypos) * svg::CHAR_CELL_HEIGHT + CHAR_OFFSET_Y, gateCssClass(flat, node), {});
     }
 
-    if(expression.variable() && signalCrossing.find(expression.variable()->name()) != signalCrossing.end())
-      inputPosition.emplace(expression.variable()->name(), COORD{ lineX1 + CROSSING_WIDTH, outy });
+    if(flat.variable(node) != plc::FlatExpression::NO_VARIABLE && signalCrossing.find(flat.variable(node)) != signalCrossing.end())
+      inputPosition.emplace(flat.variable(node), COORD{ lineX1 + CROSSING_WIDTH, outy });
 
-    expressionJsEquation(expression);
+    expressionJsEquation(flat, node);
 
     return size;
   }
@@ -209,25 +210,22 @@ private:
     return crossingWidth * svg::CHAR_CELL_WIDTH;
   }
 
-  void convertInput(const plc::Term& term, unsigned level, unsigned y, unsigned width)
+  void convertInput(const Variable& variable, bool negated, unsigned level, unsigned y, unsigned width)
   {
-    const Variable& variable = *term.variable();
-
     unsigned x = XSTART;
-    auto input = inputPosition.find(term.variable()->name());
+    auto input = inputPosition.find(variable.id());
 
     std::string cssClass(variableCssClass(variable));
     if (input == inputPosition.end() )
     {
-      auto inputCount = inputCountMap.find(term.variable()->name());
-      if (inputCount != inputCountMap.end() && inputCount->second > 1)
+      if (inputCount(variable) > 1)
       {
-        //std::cout << "crossing " << term.variable()->name() << ": " << crossingCount << std::endl;
-        inputPosition.emplace(term.variable()->name(), COORD{ XSTART + textWidth + crossingCount * CROSSING_WIDTH, y });
+        //std::cout << "crossing " << variable.name() << ": " << crossingCount << std::endl;
+        inputPosition.emplace(variable.id(), COORD{ XSTART + textWidth + crossingCount * CROSSING_WIDTH, y });
         ++crossingCount;
       }
 
-      svgOut << svg::Text(x, y + CHAR_OFFSET_Y, term.variable()->name(), { VARIABLE, cssClass.c_str() }, cssClass.c_str());
+      svgOut << svg::Text(x, y + CHAR_OFFSET_Y, variable.name(), { VARIABLE, cssClass.c_str() }, cssClass.c_str());
     }
     else
     {
@@ -240,7 +238,7 @@ private:
     
     int lineX1 = crossingWidthUpToLevel(level) + width;
 
-    if (term.unary() == plc::Term::Unary::None)
+    if (!negated)
       svgOut << svg::Line(x, y, lineX1, y, { LINK, cssClass.c_str() });
     else
       svgOut << svg::Line(x, y, lineX1 - 2 * INVERT_RADIUS, y, { LINK, cssClass.c_str() })
@@ -250,11 +248,11 @@ private:
       svgOut << svg::Text(lineX1 - 3 * svg::CHAR_CELL_WIDTH, y + CHAR_OFFSET_Y, cssClass.c_str(), {});
   }
   
-  unsigned jsType(const plc::Expression& expression) const
+  unsigned jsType(const plc::FlatExpression& flat, unsigned node) const
   {
-    if(expression.variable())
+    if(flat.variable(node) != plc::FlatExpression::NO_VARIABLE)
     {
-      return static_cast<unsigned>(expression.variable()->type());
+      return static_cast<unsigned>(plcAst.variable(flat.variable(node)).type());
     }
     else
     {
@@ -262,51 +260,40 @@ private:
     }
   }
 
-  unsigned jsTypeIndex(const plc::Expression& expression) const
+  unsigned jsTypeIndex(const plc::FlatExpression& flat, unsigned node) const
   {
-    if (expression.variable())
+    if (flat.variable(node) != plc::FlatExpression::NO_VARIABLE)
     {
-      return expression.variable()->index();
+      return plcAst.variable(flat.variable(node)).index();
     }
     else
     {
-      return expression.id();
+      return flat.id(node);
     }
   }
 
-  void expressionJsEquation(const plc::Expression& expression)
+  void expressionJsEquation(const plc::FlatExpression& flat, unsigned node)
   {
-    unsigned type = jsType(expression);
+    unsigned type = jsType(flat, node);
     if (!hasOption(SVGOption::NotInteractive) || 
       (type != static_cast<unsigned>(Variable::Type::Monoflop) && (type != static_cast<unsigned>(Variable::Type::Output))))
     {
-      jsOut << "data[" << jsType(expression) << "][" << jsTypeIndex(expression) << "]= ";
+      jsOut << "data[" << jsType(flat, node) << "][" << jsTypeIndex(flat, node) << "]= ";
 
       bool first = true;
-      char opChar = (expression.op() == plc::Expression::Operator::And) ? '&' : '|';
-      for (const plc::Term& t : expression.terms())
+      char opChar = (flat.op(node) == plc::Expression::Operator::And) ? '&' : '|';
+      for (const unsigned *child = flat.childrenBegin(node); child != flat.childrenEnd(node); child++)
       {
         if (first)
           first = false;
         else
           jsOut << ' ' << opChar << ' ';
 
-        if (t.unary() == plc::Term::Unary::Not)
+        if (flat.negated(*child))
           jsOut << '!';
 
-        switch (t.type())
-        {
-        case plc::Term::Type::Identifier:
-        {
-          const Variable& v = plcAst.getVariable(t.variable()->name());
-          jsOut << "data[" << static_cast<int>(v.type()) << "][" << v.index() << ']';
-        }
-        break;
-
-        case plc::Term::Type::Expression:
-          jsOut << "data[" << jsType(*t.expression()) << "][" << jsTypeIndex(*t.expression()) << ']';
-          break;
-        }
+        // a read is a Variable node, its type and index are those of the variable
+        jsOut << "data[" << jsType(flat, *child) << "][" << jsTypeIndex(flat, *child) << ']';
       }
 
       jsOut << ";" << std::endl;
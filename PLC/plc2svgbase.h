@@ -3,6 +3,7 @@
 
 #include "SvgOption.h"
 #include "PlcAst.h"
+#include "PlcFlatExpression.h"
 #include "svgHelper.h"
 
 
@@ -10,13 +11,15 @@ class Plc2svgBase
 {
 public:
 
-  Plc2svgBase(const PlcAst& plcAst, std::ostream& out, const std::initializer_list<SVGOption> options) : plcAst(plcAst), out(out)
+  Plc2svgBase(const PlcAst& plcAst, std::ostream& out, const std::initializer_list<SVGOption> options)
+    : plcAst(plcAst), out(out), lastGateId(plcAst.arena().lastId())
   {
     setupOptions(options.begin(), options.end());
   }
 
   template<typename AT>
-  Plc2svgBase(const PlcAst& plcAst, std::ostream& out, const AT& options) : plcAst(plcAst), out(out)
+  Plc2svgBase(const PlcAst& plcAst, std::ostream& out, const AT& options)
+    : plcAst(plcAst), out(out), lastGateId(plcAst.arena().lastId())
   {
     setupOptions(options.begin(), options.end());
   }
@@ -74,7 +77,7 @@ protected:
         << 1 + plcAst.maxVariableIndexOfType(Variable::Type::Output) << ", "
         << 1 + plcAst.maxVariableIndexOfType(Variable::Type::Monoflop) << ", "
         << 1 + plcAst.maxVariableIndexOfType(Variable::Type::Flag) << ", "
-        << 1 + plc::Expression::lastId() << ", function(data) {" << std::endl
+        << 1 + lastGateId << ", function(data) {" << std::endl
         << jsOut.str()
         << "});" << std::endl;
 
@@ -83,10 +86,10 @@ protected:
         out
           << "var that=this;" << std::endl
           << "this.toggleInput = function(event) { that.svg.toggleById(event.target.id); } " << std::endl;
-        for (auto it = inputCountMap.begin(); it != inputCountMap.end(); it++)
-          if (signalCrossing.find(it->first) == signalCrossing.end())
+        for (unsigned id = 0; id < inputCounts.size(); id++)
+          if (inputCounts[id] && signalCrossing.find(id) == signalCrossing.end())
           {
-            const Variable& variable = plcAst.getVariable(it->first);
+            const Variable& variable = plcAst.variable(id);
             unsigned index = variable.index();
 
             out << "document.getElementById('" << variableTypeIdentifier(variable.type()) << index << "').addEventListener('click',that.toggleInput);" << std::endl;
@@ -126,13 +129,13 @@ protected:
     return tmpCssClass.c_str();
   }
 
-  const char *gateCssClass(const plc::Expression& expression)
+  const char *gateCssClass(const plc::FlatExpression& flat, unsigned node)
   {
-    if (expression.variable())
-      return variableCssClass(*expression.variable());
+    if (flat.variable(node) != plc::FlatExpression::NO_VARIABLE)
+      return variableCssClass(plcAst.variable(flat.variable(node)));
 
     std::ostringstream out;
-    out << 'g' << expression.id();
+    out << 'g' << flat.id(node);
     tmpCssClass = out.str();
 
     return tmpCssClass.c_str();
@@ -159,9 +162,18 @@ protected:
     unsigned y;
   };
 
-  std::unordered_map<std::string, unsigned> inputCountMap;
-  std::unordered_map<std::string, COORD> inputPosition;
-  std::unordered_set<std::string> signalCrossing;
+  /// <summary>
+  /// The number of reads of a variable in the converted expressions
+  /// </summary>
+  unsigned inputCount(const Variable& variable) const
+  {
+    return variable.id() < inputCounts.size() ? inputCounts[variable.id()] : 0;
+  }
+
+  // by Variable::id()
+  std::vector<unsigned> inputCounts;
+  std::unordered_map<unsigned, COORD> inputPosition;
+  std::unordered_set<unsigned> signalCrossing;
 
   std::ostringstream svgOut;
   std::ostringstream jsOut;
@@ -169,6 +181,9 @@ protected:
   const PlcAst& plcAst;
   std::ostream& out;
 
+  // the gates are named by Expression::id(), the ones of expressions outside the arena of plcAst follow its last id
+  unsigned lastGateId;
+
   std::string tmpCssClass;
 
 private:
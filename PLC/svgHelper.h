@@ -32,6 +32,7 @@ namespace svg
   constexpr const char *FALSE = "false";
   constexpr const char *TRUE = "true";
   
+  // the size of the SVG drawn by the current thread
   class AreaSize
   {
   public:
@@ -65,14 +66,14 @@ namespace svg
 
     static int& xMax()
     {
-      static int x = 0;
+      static thread_local int x = 0;
 
       return x;
     }
 
     static int& yMax()
     {
-      static int y = 0;
+      static thread_local int y = 0;
 
       return y;
     }